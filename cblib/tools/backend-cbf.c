@@ -18,63 +18,134 @@
 
 #include "backend-cbf.h"
 #include "cbf-format.h"
+#include "cbf-dtoa.h"
+#include "cbf-stream.h"
+#include "cbf-thread.h"
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Entries of a coordinate block between two positions in the section index
+#define CBF_SECTION_STRIDE  65536
+
+// Entries of a coordinate block formatted by one task, a divisor of CBF_SECTION_STRIDE
+#define CBF_FORMAT_CHUNK  (CBF_SECTION_STRIDE / 4)
+
+// Upper bound on the length of a formatted integer and a separating blank
+#define CBF_FORMAT_INTLEN  21
+
+/*
+ * Columns of a coordinate block. Index k is read from lsub[k] if not NULL
+ * and from isub[k] otherwise.
+ */
+typedef struct CBFcolumns_struct {
+
+  int                  subnum;
+  const long long int *lsub[4];
+  const int           *isub[4];
+  const double        *val;
+
+} CBFcolumns;
+
+struct CBFwriter_struct {
+
+  CBFstream *pFile;
+  CBFstream *pIndex;
+
+  // Names of the files written, removed again unless complete (NULL if none)
+  char *file;
+  char *indexfile;
+
+};
+
+// Entries [ibeg, iend) of a coordinate block, formatted into buf by a task of its own
+typedef struct CBFformatchunk_struct {
+
+  const CBFcolumns *cols;
+  long long int     ibeg;
+  long long int     iend;
+  char             *buf;
+  size_t            len;
+
+} CBFformatchunk;
 
 static CBFresponsee
   write(const char *file, const CBFdata data);
 
 static CBFresponsee
-  writeVER(FILE *pFile, const CBFdata data);
+  write_index(const char *file, const CBFdata data);
+
+static CBFresponsee
+  writebuffer(CBFbuffer *buf, const CBFdata data);
 
 static CBFresponsee
-  writeOBJSENSE(FILE *pFile, const CBFdata data);
+  writefile(const char *file, CBFbuffer *buf, const CBFdata data, int index);
+
+static CBFwriter *
+  openwriter(const char *file, CBFbuffer *buf, int index);
+
+static CBFresponsee
+  writeSECTION(CBFstream *pFile, CBFstream *pIndex, const char *keyword, long long int count);
+
+static CBFresponsee
+  writeSECTIONENTRY(CBFstream *pFile, CBFstream *pIndex, long long int i);
 
 static CBFresponsee
-  writePSDVAR(FILE *pFile, const CBFdata data);
+  writeINDEX(CBFstream *pFile, long long int idx);
 
 static CBFresponsee
-  writeVAR(FILE *pFile, const CBFdata data);
+  writeCONE(CBFstream *pFile, const char *conenam, long long int dim);
+
+static long long int
+  getCOORD(const char *keyword, const CBFdata *data, CBFcolumns *cols);
 
 static CBFresponsee
-  writeINT(FILE *pFile, const CBFdata data);
+  writeCOORD(CBFstream *pFile, CBFstream *pIndex, const char *keyword, const CBFdata *data, long long int first, long long int count);
 
 static CBFresponsee
-  writeCON(FILE *pFile, const CBFdata data);
+  writeENTRIES(CBFstream *pFile, CBFstream *pIndex, long long int first, long long int count, const CBFcolumns *cols);
 
 static CBFresponsee
-  writePSDCON(FILE *pFile, const CBFdata data);
+  writeENTRIES_parallel(CBFstream *pFile, CBFstream *pIndex, long long int first, long long int count, const CBFcolumns *cols);
+
+static void
+  formatCOORD_task(void *chunk);
+
+static char *
+  formatCOORD(char *p, const CBFcolumns *cols, long long int i);
 
 static CBFresponsee
-  writeOBJFCOORD(FILE *pFile, const CBFdata data);
+  writeVER(CBFstream *pFile, CBFstream *pIndex, const CBFdata data);
 
 static CBFresponsee
-  writeOBJACOORD(FILE *pFile, const CBFdata data);
+  writeOBJSENSE(CBFstream *pFile, CBFstream *pIndex, const CBFdata data);
 
 static CBFresponsee
-  writeOBJBCOORD(FILE *pFile, const CBFdata data);
+  writePSDVAR(CBFstream *pFile, CBFstream *pIndex, const CBFdata data);
 
 static CBFresponsee
-  writeFCOORD(FILE *pFile, const CBFdata data);
+  writeVAR(CBFstream *pFile, CBFstream *pIndex, const CBFdata data);
 
 static CBFresponsee
-  writeACOORD(FILE *pFile, const CBFdata data);
+  writeINT(CBFstream *pFile, CBFstream *pIndex, const CBFdata data);
 
 static CBFresponsee
-  writeBCOORD(FILE *pFile, const CBFdata data);
+  writeCON(CBFstream *pFile, CBFstream *pIndex, const CBFdata data);
 
 static CBFresponsee
-  writeHCOORD(FILE *pFile, const CBFdata data);
+  writePSDCON(CBFstream *pFile, CBFstream *pIndex, const CBFdata data);
 
 static CBFresponsee
-  writeDCOORD(FILE *pFile, const CBFdata data);
+  writeOBJBCOORD(CBFstream *pFile, CBFstream *pIndex, const CBFdata data);
 
 
 // -------------------------------------
 // Global variable
 // -------------------------------------
 
-CBFbackend const backend_cbf = { "cbf", "cbf", write };
+CBFbackend const backend_cbf = { "cbf", "cbf", write, writebuffer };
+CBFbackend const backend_cbf_index = { "cbf-index", "cbf", write_index };
 
 
 // -------------------------------------
@@ -82,385 +153,655 @@ CBFbackend const backend_cbf = { "cbf", "cbf", write };
 // -------------------------------------
 
 static CBFresponsee write(const char *file, const CBFdata data) {
+  return writefile(file, NULL, data, 0);
+}
+
+static CBFresponsee write_index(const char *file, const CBFdata data) {
+  return writefile(file, NULL, data, 1);
+}
+
+static CBFresponsee writebuffer(CBFbuffer *buf, const CBFdata data) {
+  return writefile(NULL, buf, data, 0);
+}
+
+// Writes to file, or to buf if file is NULL
+static CBFresponsee writefile(const char *file, CBFbuffer *buf, const CBFdata data, int index) {
   CBFresponsee res = CBF_RES_OK;
-  FILE *pFile = NULL;
+  CBFwriter *w = NULL;
+  CBFstream *pFile, *pIndex;
 
-  pFile = fopen(file, "wt");
-  if (!pFile) {
+  w = openwriter(file, buf, index);
+  if (!w) {
     return CBF_RES_ERR;
   }
+  pFile = w->pFile;
+  pIndex = w->pIndex;
 
   if (res == CBF_RES_OK)
-    res = writeVER(pFile, data);
+    res = writeVER(pFile, pIndex, data);
 
   if (res == CBF_RES_OK)
-    res = writeOBJSENSE(pFile, data);
+    res = writeOBJSENSE(pFile, pIndex, data);
 
   if (res == CBF_RES_OK)
-    res = writePSDVAR(pFile, data);
+    res = writePSDVAR(pFile, pIndex, data);
 
   if (res == CBF_RES_OK)
-    res = writeVAR(pFile, data);
+    res = writeVAR(pFile, pIndex, data);
 
   if (res == CBF_RES_OK)
-    res = writeINT(pFile, data);
+    res = writeINT(pFile, pIndex, data);
 
   if (res == CBF_RES_OK)
-    res = writeCON(pFile, data);
+    res = writeCON(pFile, pIndex, data);
 
   if (res == CBF_RES_OK)
-    res = writePSDCON(pFile, data);
+    res = writePSDCON(pFile, pIndex, data);
 
   if (res == CBF_RES_OK)
-    res = writeOBJFCOORD(pFile, data);
+    res = writeCOORD(pFile, pIndex, "OBJFCOORD", &data, 0, data.objfnnz);
 
   if (res == CBF_RES_OK)
-    res = writeOBJACOORD(pFile, data);
+    res = writeCOORD(pFile, pIndex, "OBJACOORD", &data, 0, data.objannz);
 
   if (res == CBF_RES_OK)
-    res = writeOBJBCOORD(pFile, data);
+    res = writeOBJBCOORD(pFile, pIndex, data);
 
   if (res == CBF_RES_OK)
-    res = writeFCOORD(pFile, data);
+    res = writeCOORD(pFile, pIndex, "FCOORD", &data, 0, data.fnnz);
 
   if (res == CBF_RES_OK)
-    res = writeACOORD(pFile, data);
+    res = writeCOORD(pFile, pIndex, "ACOORD", &data, 0, data.annz);
 
   if (res == CBF_RES_OK)
-    res = writeBCOORD(pFile, data);
+    res = writeCOORD(pFile, pIndex, "BCOORD", &data, 0, data.bnnz);
 
   if (res == CBF_RES_OK)
-    res = writeHCOORD(pFile, data);
+    res = writeCOORD(pFile, pIndex, "HCOORD", &data, 0, data.hnnz);
 
   if (res == CBF_RES_OK)
-    res = writeDCOORD(pFile, data);
+    res = writeCOORD(pFile, pIndex, "DCOORD", &data, 0, data.dnnz);
+
+  if (CBF_closewriter(w, res == CBF_RES_OK) != CBF_RES_OK)
+    res = CBF_RES_ERR;
 
-  fclose(pFile);
   return res;
 }
 
-static CBFresponsee writeVER(FILE *pFile, const CBFdata data)
-{
+CBFwriter * CBF_openwriter(const char *file, int index) {
+  return openwriter(file, NULL, index);
+}
+
+CBFresponsee CBF_writeblock(CBFwriter *w, const char *keyword, const CBFdata *data) {
+  if (strcmp(keyword, "VER") == 0)
+    return writeVER(w->pFile, w->pIndex, *data);
+
+  if (strcmp(keyword, "OBJSENSE") == 0)
+    return writeOBJSENSE(w->pFile, w->pIndex, *data);
+
+  if (strcmp(keyword, "PSDVAR") == 0)
+    return writePSDVAR(w->pFile, w->pIndex, *data);
+
+  if (strcmp(keyword, "VAR") == 0)
+    return writeVAR(w->pFile, w->pIndex, *data);
+
+  if (strcmp(keyword, "INT") == 0)
+    return writeINT(w->pFile, w->pIndex, *data);
+
+  if (strcmp(keyword, "CON") == 0)
+    return writeCON(w->pFile, w->pIndex, *data);
+
+  if (strcmp(keyword, "PSDCON") == 0)
+    return writePSDCON(w->pFile, w->pIndex, *data);
+
+  if (strcmp(keyword, "OBJBCOORD") == 0)
+    return writeOBJBCOORD(w->pFile, w->pIndex, *data);
+
+  return CBF_RES_ERR;
+}
+
+CBFresponsee CBF_writecoordinates(CBFwriter *w, const char *keyword, const CBFdata *data, long long int first, long long int count) {
+  return writeCOORD(w->pFile, w->pIndex, keyword, data, first, count);
+}
+
+CBFresponsee CBF_closewriter(CBFwriter *w, int complete) {
   CBFresponsee res = CBF_RES_OK;
 
-  if (fprintf(pFile, "VER\n%i\n\n", data.ver) <= 0)
+  // Marks the end of the file, so readers can detect a stale index
+  if (complete)
+    res = writeSECTION(w->pFile, w->pIndex, "END", 0);
+
+  if (CBF_closestream(w->pFile) != CBF_RES_OK)
     res = CBF_RES_ERR;
 
+  if (w->pIndex)
+    if (CBF_closestream(w->pIndex) != CBF_RES_OK)
+      res = CBF_RES_ERR;
+
+  // Incomplete output is not left behind, including output that failed to flush
+  if (!complete || res != CBF_RES_OK) {
+    if (w->file)
+      remove(w->file);
+    if (w->indexfile)
+      remove(w->indexfile);
+  }
+
+  free(w->file);
+  free(w->indexfile);
+  free(w);
   return res;
 }
 
-static CBFresponsee writeOBJSENSE(FILE *pFile, const CBFdata data)
+// Opens file, or buf if file is NULL, along with a section index if requested
+static CBFwriter * openwriter(const char *file, CBFbuffer *buf, int index) {
+  CBFwriter *w;
+  char *indexfile;
+
+  // The section index is written next to the file
+  if (index && (!file || CBF_isstdstream(file))) {
+    fprintf(CBF_messagestream(), "Section indices can only be written along with output to a named file.\n");
+    return NULL;
+  }
+
+  w = (CBFwriter*) calloc(1, sizeof(*w));
+  if (!w) {
+    return NULL;
+  }
+
+  w->pFile = file ? CBF_openstream(file, "w") : CBF_openbufferstream(buf);
+  if (!w->pFile) {
+    free(w);
+    return NULL;
+  }
+
+  if (file && !CBF_isstdstream(file)) {
+    w->file = (char*) malloc(strlen(file) + 1);
+    if (w->file)
+      strcpy(w->file, file);
+  }
+
+  if (index) {
+    indexfile = (char*) malloc(strlen(file) + strlen(CBF_SECTION_EXTENSION) + 1);
+    if (indexfile) {
+      strcpy(indexfile, file);
+      strcat(indexfile, CBF_SECTION_EXTENSION);
+      w->pIndex = CBF_openstream(indexfile, "w");
+      if (w->pIndex)
+        w->indexfile = indexfile;
+      else
+        free(indexfile);
+    }
+
+    if (!w->pIndex || CBF_streamprintf(w->pIndex, "# KEYWORD OFFSET LINE COUNT\n") <= 0) {
+      CBF_closewriter(w, 0);
+      return NULL;
+    }
+  }
+
+  return w;
+}
+
+static CBFresponsee writeSECTION(CBFstream *pFile, CBFstream *pIndex, const char *keyword, long long int count)
 {
   CBFresponsee res = CBF_RES_OK;
-  const char * objsensenam;
+  long long int offset, lines;
 
-  res = CBF_objsensetostr(data.objsense, &objsensenam);
+  if (pIndex)
+  {
+    CBF_streamtell(pFile, &offset, &lines);
 
-  if (res == CBF_RES_OK)
-    if (fprintf(pFile, "OBJSENSE\n%s\n\n", objsensenam) <= 0)
+    if (CBF_streamprintf(pIndex, "%s %lli %lli %lli\n", keyword, offset, lines+1, count) <= 0)
       res = CBF_RES_ERR;
+  }
 
   return res;
 }
 
-static CBFresponsee writeCON(FILE *pFile, const CBFdata data)
+static CBFresponsee writeSECTIONENTRY(CBFstream *pFile, CBFstream *pIndex, long long int i)
 {
   CBFresponsee res = CBF_RES_OK;
-  const char *conenam;
-  long long int i;
+  long long int offset, lines;
 
-  if (data.mapnum >= 1 || data.mapstacknum >= 1)
+  if (pIndex && i >= 1 && i % CBF_SECTION_STRIDE == 0)
   {
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "CON\n%lli %lli\n", data.mapnum, data.mapstacknum) <= 0)
-        res = CBF_RES_ERR;
-
-    for (i=0; i<data.mapstacknum && res==CBF_RES_OK; ++i) {
-      CBF_conetostr(data.mapstackdomain[i], &conenam);
-
-      if (fprintf(pFile, "%s %lli\n", conenam, data.mapstackdim[i]) <= 0)
-        res = CBF_RES_ERR;
-    }
+    CBF_streamtell(pFile, &offset, &lines);
 
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
-        res = CBF_RES_ERR;
+    if (CBF_streamprintf(pIndex, "+ %lli %lli %lli\n", offset, lines+1, i) <= 0)
+      res = CBF_RES_ERR;
   }
 
   return res;
 }
 
-static CBFresponsee writeVAR(FILE *pFile, const CBFdata data)
+static CBFresponsee writeINDEX(CBFstream *pFile, long long int idx)
 {
-  CBFresponsee res = CBF_RES_OK;
-  const char *conenam;
-  long long int i;
+  char *p;
 
-  if (data.varnum >= 1 || data.varstacknum >= 1)
-  {
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "VAR\n%lli %lli\n", data.varnum, data.varstacknum) <= 0)
-        res = CBF_RES_ERR;
+  p = CBF_streamreserve(pFile, CBF_DTOA_BUFSIZE);
+  if (!p)
+    return CBF_RES_ERR;
 
-    for (i=0; i<data.varstacknum && res==CBF_RES_OK; ++i) {
-      CBF_conetostr(data.varstackdomain[i], &conenam);
+  p += CBF_lltoa(idx, p);
+  *p++ = '\n';
 
-      if (fprintf(pFile, "%s %lli\n", conenam, data.varstackdim[i]) <= 0)
-        res = CBF_RES_ERR;
-    }
+  CBF_streamcommit(pFile, p);
+  return CBF_RES_OK;
+}
 
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
-        res = CBF_RES_ERR;
+static CBFresponsee writeCONE(CBFstream *pFile, const char *conenam, long long int dim)
+{
+  size_t len = strlen(conenam);
+  char *p;
+
+  p = CBF_streamreserve(pFile, len + CBF_DTOA_BUFSIZE);
+  if (!p)
+    return CBF_RES_ERR;
+
+  memcpy(p, conenam, len);
+  p += len;
+  *p++ = ' ';
+  p += CBF_lltoa(dim, p);
+  *p++ = '\n';
+
+  CBF_streamcommit(pFile, p);
+  return CBF_RES_OK;
+}
+
+// Columns of the coordinate block of keyword in data, and its number of entries (-1 if unknown)
+static long long int getCOORD(const char *keyword, const CBFdata *data, CBFcolumns *cols)
+{
+  memset(cols, 0, sizeof(*cols));
+
+  if (strcmp(keyword, "OBJFCOORD") == 0) {
+    cols->subnum = 3;
+    cols->isub[0] = data->objfsubj;
+    cols->isub[1] = data->objfsubk;
+    cols->isub[2] = data->objfsubl;
+    cols->val = data->objfval;
+    return data->objfnnz;
   }
 
-  return res;
+  if (strcmp(keyword, "OBJACOORD") == 0) {
+    cols->subnum = 1;
+    cols->lsub[0] = data->objasubj;
+    cols->val = data->objaval;
+    return data->objannz;
+  }
+
+  if (strcmp(keyword, "FCOORD") == 0) {
+    cols->subnum = 4;
+    cols->lsub[0] = data->fsubi;
+    cols->isub[1] = data->fsubj;
+    cols->isub[2] = data->fsubk;
+    cols->isub[3] = data->fsubl;
+    cols->val = data->fval;
+    return data->fnnz;
+  }
+
+  if (strcmp(keyword, "ACOORD") == 0) {
+    cols->subnum = 2;
+    cols->lsub[0] = data->asubi;
+    cols->lsub[1] = data->asubj;
+    cols->val = data->aval;
+    return data->annz;
+  }
+
+  if (strcmp(keyword, "BCOORD") == 0) {
+    cols->subnum = 1;
+    cols->lsub[0] = data->bsubi;
+    cols->val = data->bval;
+    return data->bnnz;
+  }
+
+  if (strcmp(keyword, "HCOORD") == 0) {
+    cols->subnum = 4;
+    cols->isub[0] = data->hsubi;
+    cols->lsub[1] = data->hsubj;
+    cols->isub[2] = data->hsubk;
+    cols->isub[3] = data->hsubl;
+    cols->val = data->hval;
+    return data->hnnz;
+  }
+
+  if (strcmp(keyword, "DCOORD") == 0) {
+    cols->subnum = 3;
+    cols->isub[0] = data->dsubi;
+    cols->isub[1] = data->dsubk;
+    cols->isub[2] = data->dsubl;
+    cols->val = data->dval;
+    return data->dnnz;
+  }
+
+  return -1;
 }
 
-static CBFresponsee writeINT(FILE *pFile, const CBFdata data)
+/*
+ * Writes entries [first, first+count) of the coordinate block of keyword,
+ * found at index 0, 1, ... of its arrays in data, followed by the end of
+ * the block if they are the last ones.
+ */
+static CBFresponsee writeCOORD(CBFstream *pFile, CBFstream *pIndex, const char *keyword, const CBFdata *data, long long int first, long long int count)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
+  CBFcolumns cols;
+  long long int nnz;
 
-  if (data.intvarnum >= 1)
+  nnz = getCOORD(keyword, data, &cols);
+  if (nnz < 0)
+    return CBF_RES_ERR;
+
+  if (nnz >= 1)
   {
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "INT\n%lli\n", data.intvarnum) <= 0)
-        res = CBF_RES_ERR;
+    if (res == CBF_RES_OK && first == 0)
+      res = writeSECTION(pFile, pIndex, keyword, nnz);
 
-    for (i=0; i<data.intvarnum && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%lli\n", data.intvar[i]) <= 0)
+    if (res == CBF_RES_OK && first == 0)
+      if (CBF_streamprintf(pFile, "%s\n%lli\n", keyword, nnz) <= 0)
         res = CBF_RES_ERR;
 
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
+      res = writeENTRIES(pFile, pIndex, first, count, &cols);
+
+    if (res == CBF_RES_OK && first + count == nnz)
+      if (CBF_streamprintf(pFile, "\n") <= 0)
         res = CBF_RES_ERR;
   }
 
   return res;
 }
 
-static CBFresponsee writePSDCON(FILE *pFile, const CBFdata data)
+// Writes entries [first, first+count) of a block, found at index 0, 1, ... of cols
+static CBFresponsee writeENTRIES(CBFstream *pFile, CBFstream *pIndex, long long int first, long long int count, const CBFcolumns *cols)
 {
   CBFresponsee res = CBF_RES_OK;
-  int i;
+  long long int i;
+  char *p;
 
-  if (data.psdmapnum >= 1)
-  {
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "PSDCON\n%i\n", data.psdmapnum) <= 0)
-        res = CBF_RES_ERR;
+  if (CBF_getthreads() >= 2 && count > CBF_FORMAT_CHUNK)
+    return writeENTRIES_parallel(pFile, pIndex, first, count, cols);
 
-    for (i=0; i<data.psdmapnum && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%i\n", data.psdmapdim[i]) <= 0)
-        res = CBF_RES_ERR;
+  for (i=0; i<count && res==CBF_RES_OK; ++i) {
+    res = writeSECTIONENTRY(pFile, pIndex, first + i);
 
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
+    if (res == CBF_RES_OK) {
+      p = CBF_streamreserve(pFile, CBF_MAX_LINE);
+      if (p)
+        CBF_streamcommit(pFile, formatCOORD(p, cols, i));
+      else
         res = CBF_RES_ERR;
+    }
   }
 
   return res;
 }
 
-static CBFresponsee writePSDVAR(FILE *pFile, const CBFdata data)
+/*
+ * Formats rounds of one chunk per thread into buffers of their own, and
+ * writes them in order. The section index only points at entries that are
+ * multiples of CBF_SECTION_STRIDE, so it comes out the same as from the
+ * serial loop as long as first is a multiple of CBF_FORMAT_CHUNK.
+ */
+static CBFresponsee writeENTRIES_parallel(CBFstream *pFile, CBFstream *pIndex, long long int first, long long int count, const CBFcolumns *cols)
 {
   CBFresponsee res = CBF_RES_OK;
-  int i;
+  CBFformatchunk *chunks;
+  long long int i;
+  size_t size;
+  int c, maxchunks, numchunks;
 
-  if (data.psdvarnum >= 1)
-  {
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "PSDVAR\n%i\n", data.psdvarnum) <= 0)
-        res = CBF_RES_ERR;
+  maxchunks = CBF_getthreads();
+  if (maxchunks > (count + CBF_FORMAT_CHUNK - 1) / CBF_FORMAT_CHUNK)
+    maxchunks = (int) ((count + CBF_FORMAT_CHUNK - 1) / CBF_FORMAT_CHUNK);
 
-    for (i=0; i<data.psdvarnum && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%i\n", data.psdvardim[i]) <= 0)
-        res = CBF_RES_ERR;
+  size = CBF_FORMAT_CHUNK * (size_t) (cols->subnum * CBF_FORMAT_INTLEN + CBF_DTOA_BUFSIZE);
 
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
-        res = CBF_RES_ERR;
+  chunks = (CBFformatchunk*) calloc(maxchunks, sizeof(chunks[0]));
+  if (!chunks)
+    return CBF_RES_ERR;
+
+  for (c=0; c<maxchunks && res==CBF_RES_OK; ++c) {
+    chunks[c].cols = cols;
+    chunks[c].buf = (char*) malloc(size);
+    if (!chunks[c].buf)
+      res = CBF_RES_ERR;
   }
 
+  for (i=0; i<count && res==CBF_RES_OK; ) {
+    for (numchunks=0; numchunks<maxchunks && i<count; ++numchunks) {
+      chunks[numchunks].ibeg = i;
+      chunks[numchunks].iend = (count - i > CBF_FORMAT_CHUNK) ? i + CBF_FORMAT_CHUNK : count;
+      i = chunks[numchunks].iend;
+    }
+
+    CBF_runtasks(numchunks, formatCOORD_task, chunks, sizeof(chunks[0]));
+
+    for (c=0; c<numchunks && res==CBF_RES_OK; ++c) {
+      res = writeSECTIONENTRY(pFile, pIndex, first + chunks[c].ibeg);
+
+      if (res == CBF_RES_OK)
+        res = CBF_streamwrite(pFile, chunks[c].buf, chunks[c].len);
+    }
+  }
+
+  for (c=0; c<maxchunks; ++c)
+    free(chunks[c].buf);
+
+  free(chunks);
   return res;
 }
 
-static CBFresponsee writeOBJFCOORD(FILE *pFile, const CBFdata data)
+static void formatCOORD_task(void *chunk)
 {
-  CBFresponsee res = CBF_RES_OK;
+  CBFformatchunk *ch = (CBFformatchunk*) chunk;
   long long int i;
+  char *p = ch->buf;
 
-  if (data.objfnnz >= 1)
-  {
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "OBJFCOORD\n%lli\n", data.objfnnz) <= 0)
-        res = CBF_RES_ERR;
+  for (i=ch->ibeg; i<ch->iend; ++i)
+    p = formatCOORD(p, ch->cols, i);
 
-    for (i=0; i<data.objfnnz && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%i %i %i %.16lg\n", data.objfsubj[i], data.objfsubk[i], data.objfsubl[i], data.objfval[i]) <= 0)
-        res = CBF_RES_ERR;
+  ch->len = p - ch->buf;
+}
 
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
-        res = CBF_RES_ERR;
+// Writes entry i of a coordinate block as a line, and returns the end of it
+static char * formatCOORD(char *p, const CBFcolumns *cols, long long int i)
+{
+  int k;
+
+  for (k=0; k<cols->subnum; ++k) {
+    if (cols->lsub[k])
+      p += CBF_lltoa(cols->lsub[k][i], p);
+    else
+      p += CBF_lltoa(cols->isub[k][i], p);
+    *p++ = ' ';
   }
 
+  p += CBF_dtoa(cols->val[i], p);
+  *p++ = '\n';
+  return p;
+}
+
+static CBFresponsee writeVER(CBFstream *pFile, CBFstream *pIndex, const CBFdata data)
+{
+  CBFresponsee res = CBF_RES_OK;
+
+  res = writeSECTION(pFile, pIndex, "VER", 1);
+
+  if (res == CBF_RES_OK)
+    if (CBF_streamprintf(pFile, "VER\n%i\n\n", data.ver) <= 0)
+      res = CBF_RES_ERR;
+
   return res;
 }
 
-static CBFresponsee writeOBJACOORD(FILE *pFile, const CBFdata data)
+static CBFresponsee writeOBJSENSE(CBFstream *pFile, CBFstream *pIndex, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
+  const char * objsensenam;
 
-  if (data.objannz >= 1)
-  {
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "OBJACOORD\n%lli\n", data.objannz) <= 0)
-        res = CBF_RES_ERR;
+  res = CBF_objsensetostr(data.objsense, &objsensenam);
 
-    for (i=0; i<data.objannz && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%lli %.16lg\n", data.objasubj[i], data.objaval[i]) <= 0)
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    res = writeSECTION(pFile, pIndex, "OBJSENSE", 1);
 
-    if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
-        res = CBF_RES_ERR;
-  }
+  if (res == CBF_RES_OK)
+    if (CBF_streamprintf(pFile, "OBJSENSE\n%s\n\n", objsensenam) <= 0)
+      res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee writeOBJBCOORD(FILE *pFile, const CBFdata data)
+static CBFresponsee writeCON(CBFstream *pFile, CBFstream *pIndex, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
+  const char *conenam;
+  long long int i;
 
-  if (data.objbval != 0.0)
+  if (data.mapnum >= 1 || data.mapstacknum >= 1)
   {
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "OBJBCOORD\n%lg\n", data.objbval) <= 0)
+      res = writeSECTION(pFile, pIndex, "CON", data.mapstacknum);
+
+    if (res == CBF_RES_OK)
+      if (CBF_streamprintf(pFile, "CON\n%lli %lli\n", data.mapnum, data.mapstacknum) <= 0)
         res = CBF_RES_ERR;
 
+    for (i=0; i<data.mapstacknum && res==CBF_RES_OK; ++i) {
+      CBF_conetostr(data.mapstackdomain[i], &conenam);
+      res = writeCONE(pFile, conenam, data.mapstackdim[i]);
+    }
+
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
+      if (CBF_streamprintf(pFile, "\n") <= 0)
         res = CBF_RES_ERR;
   }
 
   return res;
 }
 
-static CBFresponsee writeFCOORD(FILE *pFile, const CBFdata data)
+static CBFresponsee writeVAR(CBFstream *pFile, CBFstream *pIndex, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
+  const char *conenam;
   long long int i;
 
-  if (data.fnnz >= 1)
+  if (data.varnum >= 1 || data.varstacknum >= 1)
   {
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "FCOORD\n%lli\n", data.fnnz) <= 0)
-        res = CBF_RES_ERR;
+      res = writeSECTION(pFile, pIndex, "VAR", data.varstacknum);
 
-    for (i=0; i<data.fnnz && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%lli %i %i %i %.16lg\n", data.fsubi[i], data.fsubj[i], data.fsubk[i], data.fsubl[i], data.fval[i]) <= 0)
+    if (res == CBF_RES_OK)
+      if (CBF_streamprintf(pFile, "VAR\n%lli %lli\n", data.varnum, data.varstacknum) <= 0)
         res = CBF_RES_ERR;
 
+    for (i=0; i<data.varstacknum && res==CBF_RES_OK; ++i) {
+      CBF_conetostr(data.varstackdomain[i], &conenam);
+      res = writeCONE(pFile, conenam, data.varstackdim[i]);
+    }
+
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
+      if (CBF_streamprintf(pFile, "\n") <= 0)
         res = CBF_RES_ERR;
   }
 
   return res;
 }
 
-static CBFresponsee writeACOORD(FILE *pFile, const CBFdata data)
+static CBFresponsee writeINT(CBFstream *pFile, CBFstream *pIndex, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i;
 
-  if (data.annz >= 1)
+  if (data.intvarnum >= 1)
   {
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "ACOORD\n%lli\n", data.annz) <= 0)
-        res = CBF_RES_ERR;
+      res = writeSECTION(pFile, pIndex, "INT", data.intvarnum);
 
-    for (i=0; i<data.annz && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%lli %lli %.16lg\n", data.asubi[i], data.asubj[i], data.aval[i]) <= 0)
+    if (res == CBF_RES_OK)
+      if (CBF_streamprintf(pFile, "INT\n%lli\n", data.intvarnum) <= 0)
         res = CBF_RES_ERR;
 
+    for (i=0; i<data.intvarnum && res==CBF_RES_OK; ++i)
+      res = writeINDEX(pFile, data.intvar[i]);
+
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
+      if (CBF_streamprintf(pFile, "\n") <= 0)
         res = CBF_RES_ERR;
   }
 
   return res;
 }
 
-static CBFresponsee writeBCOORD(FILE *pFile, const CBFdata data)
+static CBFresponsee writePSDCON(CBFstream *pFile, CBFstream *pIndex, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
+  int i;
 
-  if (data.bnnz >= 1)
+  if (data.psdmapnum >= 1)
   {
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "BCOORD\n%lli\n", data.bnnz) <= 0)
-        res = CBF_RES_ERR;
+      res = writeSECTION(pFile, pIndex, "PSDCON", data.psdmapnum);
 
-    for (i=0; i<data.bnnz && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%lli %.16lg\n", data.bsubi[i], data.bval[i]) <= 0)
+    if (res == CBF_RES_OK)
+      if (CBF_streamprintf(pFile, "PSDCON\n%i\n", data.psdmapnum) <= 0)
         res = CBF_RES_ERR;
 
+    for (i=0; i<data.psdmapnum && res==CBF_RES_OK; ++i)
+      res = writeINDEX(pFile, data.psdmapdim[i]);
+
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
+      if (CBF_streamprintf(pFile, "\n") <= 0)
         res = CBF_RES_ERR;
   }
 
   return res;
 }
 
-static CBFresponsee writeHCOORD(FILE *pFile, const CBFdata data)
+static CBFresponsee writePSDVAR(CBFstream *pFile, CBFstream *pIndex, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
+  int i;
 
-  if (data.hnnz >= 1)
+  if (data.psdvarnum >= 1)
   {
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "HCOORD\n%lli\n", data.hnnz) <= 0)
-        res = CBF_RES_ERR;
+      res = writeSECTION(pFile, pIndex, "PSDVAR", data.psdvarnum);
 
-    for (i=0; i<data.hnnz && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%i %lli %i %i %.16lg\n", data.hsubi[i], data.hsubj[i], data.hsubk[i], data.hsubl[i], data.hval[i]) <= 0)
+    if (res == CBF_RES_OK)
+      if (CBF_streamprintf(pFile, "PSDVAR\n%i\n", data.psdvarnum) <= 0)
         res = CBF_RES_ERR;
 
+    for (i=0; i<data.psdvarnum && res==CBF_RES_OK; ++i)
+      res = writeINDEX(pFile, data.psdvardim[i]);
+
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
+      if (CBF_streamprintf(pFile, "\n") <= 0)
         res = CBF_RES_ERR;
   }
 
   return res;
 }
 
-static CBFresponsee writeDCOORD(FILE *pFile, const CBFdata data)
+static CBFresponsee writeOBJBCOORD(CBFstream *pFile, CBFstream *pIndex, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
+  char val[CBF_DTOA_BUFSIZE];
 
-  if (data.dnnz >= 1)
+  if (data.objbval != 0.0)
   {
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "DCOORD\n%lli\n", data.dnnz) <= 0)
-        res = CBF_RES_ERR;
+      res = writeSECTION(pFile, pIndex, "OBJBCOORD", 1);
 
-    for (i=0; i<data.dnnz && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%i %i %i %.16lg\n", data.dsubi[i], data.dsubk[i], data.dsubl[i], data.dval[i]) <= 0)
+    if (res == CBF_RES_OK) {
+      CBF_dtoa(data.objbval, val);
+      if (CBF_streamprintf(pFile, "OBJBCOORD\n%s\n", val) <= 0)
         res = CBF_RES_ERR;
+    }
 
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
+      if (CBF_streamprintf(pFile, "\n") <= 0)
         res = CBF_RES_ERR;
   }
 
   return res;
 }
+
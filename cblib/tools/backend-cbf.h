@@ -23,4 +23,36 @@
 
 extern CBFbackend const backend_cbf;
 
+// Also writes a section index of the file (see frontend-cbf.h)
+extern CBFbackend const backend_cbf_index;
+
+/*
+ * Event driven writing of a CBF file, block by block in the order of the
+ * calls, as backend_cbf (or backend_cbf_index if index) writes them. The
+ * arguments match those of CBFcallbacks (see frontend-cbf.h), so a file
+ * read by CBF_readstream can be rewritten in constant memory. With a
+ * section index, batches of coordinates should start at multiples of
+ * 65536 entries.
+ *
+ * CBF_writeblock writes an information block of data, and
+ * CBF_writecoordinates writes entries [first, first+count) of a coordinate
+ * block, found at index 0, 1, ... of its arrays in data, where the nnz
+ * field of the block holds the size of the whole block. CBF_closewriter
+ * ends the section index if complete. It fails if pending output could not
+ * be written, and then, or if not complete, removes the file and its index.
+ */
+typedef struct CBFwriter_struct CBFwriter;
+
+CBFwriter *
+  CBF_openwriter(const char *file, int index);
+
+CBFresponsee
+  CBF_writeblock(CBFwriter *w, const char *keyword, const CBFdata *data);
+
+CBFresponsee
+  CBF_writecoordinates(CBFwriter *w, const char *keyword, const CBFdata *data, long long int first, long long int count);
+
+CBFresponsee
+  CBF_closewriter(CBFwriter *w, int complete);
+
 #endif
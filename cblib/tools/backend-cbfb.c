@@ -0,0 +1,195 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "backend-cbfb.h"
+#include "cbf-binary.h"
+#include "cbf-stream.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct CBFcolumn_struct {
+  const void   *ptr;
+  long long int count;
+  size_t        size;
+} CBFcolumn;
+
+static CBFresponsee
+  write(const char *file, const CBFdata data);
+
+static CBFresponsee
+  writebuffer(CBFbuffer *buf, const CBFdata data);
+
+static CBFresponsee
+  writefile(const char *file, CBFbuffer *buf, const CBFdata data);
+
+static void
+  setcolumn(CBFcolumn *col, const void *ptr, long long int count, size_t size);
+
+static void
+  setcolumns(CBFcolumn *cols, const CBFdata data);
+
+static CBFresponsee
+  writepadding(CBFstream *pFile, long long int from, long long int to);
+
+
+// -------------------------------------
+// Global variable
+// -------------------------------------
+
+CBFbackend const backend_cbfb = { "cbfb", "cbfb", write, writebuffer };
+
+
+// -------------------------------------
+// Function definitions
+// -------------------------------------
+
+static CBFresponsee write(const char *file, const CBFdata data) {
+  return writefile(file, NULL, data);
+}
+
+static CBFresponsee writebuffer(CBFbuffer *buf, const CBFdata data) {
+  return writefile(NULL, buf, data);
+}
+
+// Writes to file, or to buf if file is NULL
+static CBFresponsee writefile(const char *file, CBFbuffer *buf, const CBFdata data) {
+  CBFresponsee res = CBF_RES_OK;
+  CBFcolumn cols[CBF_COL_END];
+  CBFbinaryheader header;
+  long long int pos;
+  CBFstream *pFile = NULL;
+  int k;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CBF_BINARY_MAGIC, sizeof(header.magic));
+  header.byteorder   = CBF_BINARY_BYTEORDER;
+  header.layout      = CBF_BINARY_LAYOUT;
+  header.ver         = data.ver;
+  header.objsense    = data.objsense;
+  header.mapnum      = data.mapnum;
+  header.mapstacknum = data.mapstacknum;
+  header.varnum      = data.varnum;
+  header.varstacknum = data.varstacknum;
+  header.intvarnum   = data.intvarnum;
+  header.psdmapnum   = data.psdmapnum;
+  header.psdvarnum   = data.psdvarnum;
+  header.objfnnz     = data.objfnnz;
+  header.objannz     = data.objannz;
+  header.objbval     = data.objbval;
+  header.fnnz        = data.fnnz;
+  header.annz        = data.annz;
+  header.bnnz        = data.bnnz;
+  header.hnnz        = data.hnnz;
+  header.dnnz        = data.dnnz;
+
+  // Lay out the columns after the header
+  setcolumns(cols, data);
+  pos = sizeof(header);
+  for (k=0; k<CBF_COL_END; ++k) {
+    if (cols[k].count >= 1) {
+      pos = (pos + CBF_BINARY_ALIGN - 1) / CBF_BINARY_ALIGN * CBF_BINARY_ALIGN;
+      header.offset[k] = pos;
+      pos += cols[k].count * (long long int)cols[k].size;
+    }
+  }
+
+  pFile = file ? CBF_openstream(file, "w") : CBF_openbufferstream(buf);
+  if (!pFile) {
+    return CBF_RES_ERR;
+  }
+
+  res = CBF_streamwrite(pFile, (const char*) &header, sizeof(header));
+
+  pos = sizeof(header);
+  for (k=0; k<CBF_COL_END && res==CBF_RES_OK; ++k) {
+    if (cols[k].count >= 1) {
+      res = writepadding(pFile, pos, header.offset[k]);
+
+      if (res == CBF_RES_OK)
+        res = CBF_streamwrite(pFile, (const char*) cols[k].ptr, cols[k].count * cols[k].size);
+
+      pos = header.offset[k] + cols[k].count * (long long int)cols[k].size;
+    }
+  }
+
+  if (CBF_closestream(pFile) != CBF_RES_OK)
+    res = CBF_RES_ERR;
+
+  return res;
+}
+
+static void setcolumn(CBFcolumn *col, const void *ptr, long long int count, size_t size)
+{
+  col->ptr   = ptr;
+  col->count = count;
+  col->size  = size;
+}
+
+static void setcolumns(CBFcolumn *cols, const CBFdata data)
+{
+  setcolumn(&cols[CBF_COL_MAPSTACKDIM],    data.mapstackdim,    data.mapstacknum, sizeof(data.mapstackdim[0]));
+  setcolumn(&cols[CBF_COL_MAPSTACKDOMAIN], data.mapstackdomain, data.mapstacknum, sizeof(data.mapstackdomain[0]));
+  setcolumn(&cols[CBF_COL_VARSTACKDIM],    data.varstackdim,    data.varstacknum, sizeof(data.varstackdim[0]));
+  setcolumn(&cols[CBF_COL_VARSTACKDOMAIN], data.varstackdomain, data.varstacknum, sizeof(data.varstackdomain[0]));
+  setcolumn(&cols[CBF_COL_INTVAR],         data.intvar,         data.intvarnum,   sizeof(data.intvar[0]));
+  setcolumn(&cols[CBF_COL_PSDMAPDIM],      data.psdmapdim,      data.psdmapnum,   sizeof(data.psdmapdim[0]));
+  setcolumn(&cols[CBF_COL_PSDVARDIM],      data.psdvardim,      data.psdvarnum,   sizeof(data.psdvardim[0]));
+
+  setcolumn(&cols[CBF_COL_OBJFSUBJ], data.objfsubj, data.objfnnz, sizeof(data.objfsubj[0]));
+  setcolumn(&cols[CBF_COL_OBJFSUBK], data.objfsubk, data.objfnnz, sizeof(data.objfsubk[0]));
+  setcolumn(&cols[CBF_COL_OBJFSUBL], data.objfsubl, data.objfnnz, sizeof(data.objfsubl[0]));
+  setcolumn(&cols[CBF_COL_OBJFVAL],  data.objfval,  data.objfnnz, sizeof(data.objfval[0]));
+
+  setcolumn(&cols[CBF_COL_OBJASUBJ], data.objasubj, data.objannz, sizeof(data.objasubj[0]));
+  setcolumn(&cols[CBF_COL_OBJAVAL],  data.objaval,  data.objannz, sizeof(data.objaval[0]));
+
+  setcolumn(&cols[CBF_COL_FSUBI], data.fsubi, data.fnnz, sizeof(data.fsubi[0]));
+  setcolumn(&cols[CBF_COL_FSUBJ], data.fsubj, data.fnnz, sizeof(data.fsubj[0]));
+  setcolumn(&cols[CBF_COL_FSUBK], data.fsubk, data.fnnz, sizeof(data.fsubk[0]));
+  setcolumn(&cols[CBF_COL_FSUBL], data.fsubl, data.fnnz, sizeof(data.fsubl[0]));
+  setcolumn(&cols[CBF_COL_FVAL],  data.fval,  data.fnnz, sizeof(data.fval[0]));
+
+  setcolumn(&cols[CBF_COL_ASUBI], data.asubi, data.annz, sizeof(data.asubi[0]));
+  setcolumn(&cols[CBF_COL_ASUBJ], data.asubj, data.annz, sizeof(data.asubj[0]));
+  setcolumn(&cols[CBF_COL_AVAL],  data.aval,  data.annz, sizeof(data.aval[0]));
+
+  setcolumn(&cols[CBF_COL_BSUBI], data.bsubi, data.bnnz, sizeof(data.bsubi[0]));
+  setcolumn(&cols[CBF_COL_BVAL],  data.bval,  data.bnnz, sizeof(data.bval[0]));
+
+  setcolumn(&cols[CBF_COL_HSUBI], data.hsubi, data.hnnz, sizeof(data.hsubi[0]));
+  setcolumn(&cols[CBF_COL_HSUBJ], data.hsubj, data.hnnz, sizeof(data.hsubj[0]));
+  setcolumn(&cols[CBF_COL_HSUBK], data.hsubk, data.hnnz, sizeof(data.hsubk[0]));
+  setcolumn(&cols[CBF_COL_HSUBL], data.hsubl, data.hnnz, sizeof(data.hsubl[0]));
+  setcolumn(&cols[CBF_COL_HVAL],  data.hval,  data.hnnz, sizeof(data.hval[0]));
+
+  setcolumn(&cols[CBF_COL_DSUBI], data.dsubi, data.dnnz, sizeof(data.dsubi[0]));
+  setcolumn(&cols[CBF_COL_DSUBK], data.dsubk, data.dnnz, sizeof(data.dsubk[0]));
+  setcolumn(&cols[CBF_COL_DSUBL], data.dsubl, data.dnnz, sizeof(data.dsubl[0]));
+  setcolumn(&cols[CBF_COL_DVAL],  data.dval,  data.dnnz, sizeof(data.dval[0]));
+}
+
+static CBFresponsee writepadding(CBFstream *pFile, long long int from, long long int to)
+{
+  static const char zeros[CBF_BINARY_ALIGN] = { 0, };
+
+  if (to > from)
+    return CBF_streamwrite(pFile, zeros, to - from);
+
+  return CBF_RES_OK;
+}
@@ -25,17 +25,23 @@ static CBFresponsee
   write(const char *file, const CBFdata data);
 
 static CBFresponsee
-  writeROWS(FILE *pFile, const CBFdata data);
+  writebuffer(CBFbuffer *buf, const CBFdata data);
 
 static CBFresponsee
-  writeQCMATRIX(FILE *pFile, const CBFdata data);
+  writefile(const char *file, CBFbuffer *buf, const CBFdata data);
+
+static CBFresponsee
+  writeROWS(CBFstream *pFile, const CBFdata data);
+
+static CBFresponsee
+  writeQCMATRIX(CBFstream *pFile, const CBFdata data);
 
 
 // -------------------------------------
 // Global variable
 // -------------------------------------
 
-CBFbackend const backend_mps_cplex = { "mps-cplex", "mps", write };
+CBFbackend const backend_mps_cplex = { "mps-cplex", "mps", write, writebuffer };
 
 
 // -------------------------------------
@@ -43,15 +49,24 @@ CBFbackend const backend_mps_cplex = { "mps-cplex", "mps", write };
 // -------------------------------------
 
 static CBFresponsee write(const char *file, const CBFdata data) {
+  return writefile(file, NULL, data);
+}
+
+static CBFresponsee writebuffer(CBFbuffer *buf, const CBFdata data) {
+  return writefile(NULL, buf, data);
+}
+
+// Writes to file, or to buf if file is NULL
+static CBFresponsee writefile(const char *file, CBFbuffer *buf, const CBFdata data) {
   CBFresponsee res = CBF_RES_OK;
-  FILE *pFile = NULL;
+  CBFstream *pFile = NULL;
 
   if (data.psdmapnum >= 1 || data.psdvarnum >= 1) {
-    printf("Positive semidefinite domains are not supported in the selected output file format.\n");
+    fprintf(CBF_messagestream(), "Positive semidefinite domains are not supported in the selected output file format.\n");
     return CBF_RES_ERR;
   }
 
-  pFile = fopen(file, "wt");
+  pFile = file ? CBF_openstream(file, "w") : CBF_openbufferstream(buf);
   if (!pFile) {
     return CBF_RES_ERR;
   }
@@ -80,11 +95,13 @@ static CBFresponsee write(const char *file, const CBFdata data) {
   if (res == CBF_RES_OK)
     res = MPS_writeENDATA(pFile, data);
 
-  fclose(pFile);
+  if (CBF_closestream(pFile) != CBF_RES_OK)
+    res = CBF_RES_ERR;
+
   return res;
 }
 
-static CBFresponsee writeROWS(FILE *pFile, const CBFdata data)
+static CBFresponsee writeROWS(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i;
@@ -98,8 +115,7 @@ static CBFresponsee writeROWS(FILE *pFile, const CBFdata data)
     case CBF_CONE_QUAD:
     case CBF_CONE_RQUAD:
       if (res == CBF_RES_OK)
-        if (fprintf(pFile, " %s  xK%lli\n", "L", i) <= 0)
-          res = CBF_RES_ERR;
+        res = MPS_writeDATA(pFile, "L", "xK", i, NULL, -1, NULL);
       break;
 
     default:
@@ -112,8 +128,7 @@ static CBFresponsee writeROWS(FILE *pFile, const CBFdata data)
     case CBF_CONE_QUAD:
     case CBF_CONE_RQUAD:
       if (res == CBF_RES_OK)
-        if (fprintf(pFile, " %s  xgK%lli\n", "L", i) <= 0)
-          res = CBF_RES_ERR;
+        res = MPS_writeDATA(pFile, "L", "xgK", i, NULL, -1, NULL);
       break;
 
     default:
@@ -124,7 +139,7 @@ static CBFresponsee writeROWS(FILE *pFile, const CBFdata data)
   return res;
 }
 
-static CBFresponsee writeQCMATRIX(FILE *pFile, const CBFdata data)
+static CBFresponsee writeQCMATRIX(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i, j, curvar = 0, curmap = 0;
@@ -139,24 +154,25 @@ static CBFresponsee writeQCMATRIX(FILE *pFile, const CBFdata data)
     }
 
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "%-10s xK%lli\n", "QCMATRIX", i) <= 0)
+      if (CBF_streamprintf(pFile, "%-10s xK%lli\n", "QCMATRIX", i) <= 0)
         res = CBF_RES_ERR;
 
     if (res == CBF_RES_OK) {
       if (data.varstackdomain[i] == CBF_CONE_QUAD) {
-        if (fprintf(pFile, "    x%-8lli x%-8lli %.16lg\n    x%-8lli x%-8lli %.16lg\n", curvar, curvar, -1.0, curvar+1, curvar+1, 1.0) <= 0)
-          res = CBF_RES_ERR;
+        res = MPS_writeDATA(pFile, "", "x", curvar, "x", curvar, "-1");
+        if (res == CBF_RES_OK)
+          res = MPS_writeDATA(pFile, "", "x", curvar+1, "x", curvar+1, "1");
 
       } else if (data.varstackdomain[i] == CBF_CONE_RQUAD) {
-        if (fprintf(pFile, "    x%-8lli x%-8lli %.16lg\n    x%-8lli x%-8lli %.16lg\n", curvar, curvar+1, -1.0, curvar+1, curvar, -1.0) <= 0)
-          res = CBF_RES_ERR;
+        res = MPS_writeDATA(pFile, "", "x", curvar, "x", curvar+1, "-1");
+        if (res == CBF_RES_OK)
+          res = MPS_writeDATA(pFile, "", "x", curvar+1, "x", curvar, "-1");
       }
     }
     curvar += 2;
 
     for (j=2; j<data.varstackdim[i] && res==CBF_RES_OK; ++j) {
-      if (fprintf(pFile, "    x%-8lli x%-8lli %.16lg\n", curvar, curvar, 1.0) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, "", "x", curvar, "x", curvar, "1");
       ++curvar;
     }
   }
@@ -171,24 +187,25 @@ static CBFresponsee writeQCMATRIX(FILE *pFile, const CBFdata data)
     }
 
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "%-10s xgK%lli\n", "QCMATRIX", i) <= 0)
+      if (CBF_streamprintf(pFile, "%-10s xgK%lli\n", "QCMATRIX", i) <= 0)
         res = CBF_RES_ERR;
 
     if (res == CBF_RES_OK) {
       if (data.mapstackdomain[i] == CBF_CONE_QUAD) {
-        if (fprintf(pFile, "    xg%-7lli xg%-7lli %.16lg\n    xg%-7lli xg%-7lli %.16lg\n", curmap, curmap, -1.0, curmap+1, curmap+1, 1.0) <= 0)
-          res = CBF_RES_ERR;
+        res = MPS_writeDATA(pFile, "", "xg", curmap, "xg", curmap, "-1");
+        if (res == CBF_RES_OK)
+          res = MPS_writeDATA(pFile, "", "xg", curmap+1, "xg", curmap+1, "1");
 
       } else if (data.mapstackdomain[i] == CBF_CONE_RQUAD) {
-        if (fprintf(pFile, "    xg%-7lli xg%-7lli %.16lg\n    xg%-7lli xg%-7lli %.16lg\n", curmap, curmap+1, -1.0, curmap+1, curmap, -1.0) <= 0)
-          res = CBF_RES_ERR;
+        res = MPS_writeDATA(pFile, "", "xg", curmap, "xg", curmap+1, "-1");
+        if (res == CBF_RES_OK)
+          res = MPS_writeDATA(pFile, "", "xg", curmap+1, "xg", curmap, "-1");
       }
     }
     curmap += 2;
 
     for (j=2; j<data.mapstackdim[i] && res==CBF_RES_OK; ++j) {
-      if (fprintf(pFile, "    xg%-7lli xg%-7lli %.16lg\n", curmap, curmap, 1.0) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, "", "xg", curmap, "xg", curmap, "1");
       ++curmap;
     }
   }
@@ -25,14 +25,20 @@ static CBFresponsee
   write(const char *file, const CBFdata data);
 
 static CBFresponsee
-  writeCSECTION(FILE *pFile, const CBFdata data);
+  writebuffer(CBFbuffer *buf, const CBFdata data);
+
+static CBFresponsee
+  writefile(const char *file, CBFbuffer *buf, const CBFdata data);
+
+static CBFresponsee
+  writeCSECTION(CBFstream *pFile, const CBFdata data);
 
 
 // -------------------------------------
 // Global variable
 // -------------------------------------
 
-CBFbackend const backend_mps_mosek = { "mps-mosek", "mps", write };
+CBFbackend const backend_mps_mosek = { "mps-mosek", "mps", write, writebuffer };
 
 
 // -------------------------------------
@@ -40,15 +46,24 @@ CBFbackend const backend_mps_mosek = { "mps-mosek", "mps", write };
 // -------------------------------------
 
 static CBFresponsee write(const char *file, const CBFdata data) {
+  return writefile(file, NULL, data);
+}
+
+static CBFresponsee writebuffer(CBFbuffer *buf, const CBFdata data) {
+  return writefile(NULL, buf, data);
+}
+
+// Writes to file, or to buf if file is NULL
+static CBFresponsee writefile(const char *file, CBFbuffer *buf, const CBFdata data) {
   CBFresponsee res = CBF_RES_OK;
-  FILE *pFile = NULL;
+  CBFstream *pFile = NULL;
 
   if (data.psdmapnum >= 1 || data.psdvarnum >= 1) {
-    printf("Positive semidefinite domains are not supported in the selected output file format.\n");
+    fprintf(CBF_messagestream(), "Positive semidefinite domains are not supported in the selected output file format.\n");
     return CBF_RES_ERR;
   }
 
-  pFile = fopen(file, "wt");
+  pFile = file ? CBF_openstream(file, "w") : CBF_openbufferstream(buf);
   if (!pFile) {
     return CBF_RES_ERR;
   }
@@ -77,11 +92,13 @@ static CBFresponsee write(const char *file, const CBFdata data) {
   if (res == CBF_RES_OK)
     res = MPS_writeENDATA(pFile, data);
 
-  fclose(pFile);
+  if (CBF_closestream(pFile) != CBF_RES_OK)
+    res = CBF_RES_ERR;
+
   return res;
 }
 
-static CBFresponsee writeCSECTION(FILE *pFile, const CBFdata data)
+static CBFresponsee writeCSECTION(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i, j, curvar = 0, curmap = 0;
@@ -97,12 +114,11 @@ static CBFresponsee writeCSECTION(FILE *pFile, const CBFdata data)
     }
 
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "%-13s xK%-7lli %-14.16lg %s\n", "CSECTION", i, 0.0, domain) <= 0)
+      if (CBF_streamprintf(pFile, "%-13s xK%-7lli %-14s %s\n", "CSECTION", i, "0", domain) <= 0)
         res = CBF_RES_ERR;
 
     for (j=0; j<data.varstackdim[i] && res==CBF_RES_OK; ++j) {
-      if (fprintf(pFile, "    x%lli\n", curvar) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, "", "x", curvar, NULL, -1, NULL);
       ++curvar;
     }
   }
@@ -117,12 +133,11 @@ static CBFresponsee writeCSECTION(FILE *pFile, const CBFdata data)
     }
 
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "%-13s xgK%-6lli %-14.16lg %s\n", "CSECTION", i, 0.0, domain) <= 0)
+      if (CBF_streamprintf(pFile, "%-13s xgK%-6lli %-14s %s\n", "CSECTION", i, "0", domain) <= 0)
         res = CBF_RES_ERR;
 
     for (j=0; j<data.mapstackdim[i] && res==CBF_RES_OK; ++j) {
-      if (fprintf(pFile, "    xg%lli\n", curmap) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, "", "xg", curmap, NULL, -1, NULL);
       ++curmap;
     }
   }
@@ -18,24 +18,29 @@
 
 #include "backend-mps.h"
 #include "cbf-helper.h"
+#include "cbf-dtoa.h"
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+
+static char *
+  MPS_putfield(char *p, const char *name, long long int idx, int width);
 
 static CBFresponsee
-  MPS_writeCOLUMNS_controlINTEGERMARK(FILE *pFile, const CBFdata data, long long int xID, const long long int *intidx, long long int *curint, long long int *curintmark, int *isintegermark);
+  MPS_writeCOLUMNS_controlINTEGERMARK(CBFstream *pFile, const CBFdata data, long long int xID, const long long int *intidx, long long int *curint, long long int *curintmark, int *isintegermark);
 
 
-CBFresponsee MPS_writeNAME(FILE *pFile, const CBFdata data)
+CBFresponsee MPS_writeNAME(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
 
-  if (fprintf(pFile, "%-14s%s\n", "NAME", "UNKNOWN") <= 0)
+  if (CBF_streamprintf(pFile, "%-14s%s\n", "NAME", "UNKNOWN") <= 0)
     res = CBF_RES_ERR;
 
   return res;
 }
 
-CBFresponsee MPS_writeOBJSENSE(FILE *pFile, const CBFdata data)
+CBFresponsee MPS_writeOBJSENSE(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   const char *sense;
@@ -48,24 +53,24 @@ CBFresponsee MPS_writeOBJSENSE(FILE *pFile, const CBFdata data)
     res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
-    if (fprintf(pFile, "OBJSENSE\n    %s\n", sense) <= 0)
+    if (CBF_streamprintf(pFile, "OBJSENSE\n    %s\n", sense) <= 0)
       res = CBF_RES_ERR;
 
   return res;
 }
 
-CBFresponsee MPS_writeROWS(FILE *pFile, const CBFdata data)
+CBFresponsee MPS_writeROWS(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i, j, curmap = 0;
   const char *domain;
 
   if (res == CBF_RES_OK)
-    if (fprintf(pFile, "ROWS\n") <= 0)
+    if (CBF_streamprintf(pFile, "ROWS\n") <= 0)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK) {
-    if (fprintf(pFile, " %s  %s\n", "N", "obj") <= 0)
+    if (CBF_streamprintf(pFile, " %s  %s\n", "N", "obj") <= 0)
       res = CBF_RES_ERR;
   }
 
@@ -84,58 +89,38 @@ CBFresponsee MPS_writeROWS(FILE *pFile, const CBFdata data)
     }
 
     for (j=0; j<data.mapstackdim[i] && res==CBF_RES_OK; ++j) {
-      if (fprintf(pFile, " %s  g%lli\n", domain, curmap) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, domain, "g", curmap, NULL, -1, NULL);
       ++curmap;
     }
   }
   return res;
 }
 
-CBFresponsee MPS_writeCOLUMNS(FILE *pFile, const CBFdata data)
+CBFresponsee MPS_writeCOLUMNS(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i, j, curmap = 0;
-  long long int *aidx = NULL, *objaidx = NULL, *intidx = NULL;
+  const long long int *aidx = NULL, *objaidx = NULL;
+  long long int *intidx = NULL;
+  CBFindex index = { 0, };
   int isintegermark = 0;
   long long int lastj = -1, curobja = 0, curint = 0, curintmark = 0;
+  char val[CBF_DTOA_BUFSIZE];
 
-  aidx = (long long int *) malloc(data.annz * sizeof(aidx[0]));
-  objaidx = (long long int *) malloc(data.objannz * sizeof(objaidx[0]));
   intidx  = (long long int *) malloc(data.intvarnum * sizeof(intidx[0]));
 
-  if (!aidx || !objaidx || !intidx) {
-    if (aidx)           free(aidx);
-    if (objaidx)        free(objaidx);
-    if (intidx)         free(intidx);
+  if (!intidx)
     return CBF_RES_ERR;
-  }
 
   //
-  // Sort a-coefficients, obja-coefficients, and integer variable indexes
+  // Order a-coefficients (primarily by asubj, secondarily by asubi) and obja-coefficients
+  // by variable with a column index, and sort integer variable indexes
   //
-  if (data.annz >= 1)
-  {
-    if (res == CBF_RES_OK)
-      for (i=0; i<data.annz; ++i)
-        aidx[i] = i;
-
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(data.mapnum-1, data.annz, data.asubi, aidx);   // secondarily by asubi
-
-    if ( res==CBF_RES_OK )
-      res = CBF_bucketsort(data.varnum-1, data.annz, data.asubj, aidx);   // primarily by asubj
-  }
-
-  if (data.objannz >= 1)
-  {
-    if (res == CBF_RES_OK)
-      for (i=0; i<data.objannz; ++i)
-        objaidx[i] = i;
+  if (res == CBF_RES_OK)
+    res = CBF_buildindex_var(&data, &index);
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(data.varnum-1, data.objannz, data.objasubj, objaidx);
-  }
+  aidx = index.acolidx;
+  objaidx = index.objacolidx;
 
   if (data.intvarnum >= 1)
   {
@@ -143,15 +128,15 @@ CBFresponsee MPS_writeCOLUMNS(FILE *pFile, const CBFdata data)
       for (i=0; i<data.intvarnum; ++i)
         intidx[i] = i;
 
-    if ( res==CBF_RES_OK )
-      res = CBF_bucketsort(data.varnum-1, data.intvarnum, data.intvar, intidx);
+    if ( res==CBF_RES_OK && !(data.sorted & CBF_SORTED_INT) )
+      res = CBF_indexsort(data.intvarnum, data.intvar, data.varnum-1, NULL, 0, intidx);
   }
 
   //
   // Write data
   //
   if (res == CBF_RES_OK)
-    if (fprintf(pFile, "COLUMNS\n") <= 0)
+    if (CBF_streamprintf(pFile, "COLUMNS\n") <= 0)
       res = CBF_RES_ERR;
 
   for (i=0; i<data.annz && res==CBF_RES_OK; ++i) {
@@ -163,14 +148,12 @@ CBFresponsee MPS_writeCOLUMNS(FILE *pFile, const CBFdata data)
 
       if ( res==CBF_RES_OK ) {
         if ( curobja < data.objannz && data.objasubj[objaidx[curobja]] == j ) {
-          if (fprintf(pFile, "    x%-8lli %-9s %.16lg\n", j, "obj", data.objaval[objaidx[curobja]]) <= 0) {
-            res = CBF_RES_ERR;
-          }
+          CBF_dtoa(data.objaval[objaidx[curobja]], val);
+          res = MPS_writeDATA(pFile, "", "x", j, "obj", -1, val);
           ++curobja;
         
         } else {
-          if (fprintf(pFile, "    x%-8lli %-9s %.16lg\n", j, "obj", 0.0) <= 0)
-            res = CBF_RES_ERR;
+          res = MPS_writeDATA(pFile, "", "x", j, "obj", -1, "0");
         }
       }
     }
@@ -182,17 +165,17 @@ CBFresponsee MPS_writeCOLUMNS(FILE *pFile, const CBFdata data)
     if ( res==CBF_RES_OK ) {
       if ( lastj != data.asubj[aidx[i]] ) {
         if ( curobja < data.objannz && data.objasubj[objaidx[curobja]] == j ) {
-          if (fprintf(pFile, "    x%-8lli %-9s %.16lg\n", j, "obj", data.objaval[objaidx[curobja]]) <= 0) {
-            res = CBF_RES_ERR;
-          }
+          CBF_dtoa(data.objaval[objaidx[curobja]], val);
+          res = MPS_writeDATA(pFile, "", "x", j, "obj", -1, val);
           ++curobja;
         }
       }
     }
     
-    if ( res==CBF_RES_OK )
-      if (fprintf(pFile, "    x%-8lli g%-8lli %.16lg\n", data.asubj[aidx[i]], data.asubi[aidx[i]], data.aval[aidx[i]]) <= 0)
-        res = CBF_RES_ERR;
+    if ( res==CBF_RES_OK ) {
+      CBF_dtoa(data.aval[aidx[i]], val);
+      res = MPS_writeDATA(pFile, "", "x", data.asubj[aidx[i]], "g", data.asubi[aidx[i]], val);
+    }
     
     lastj = data.asubj[aidx[i]];
   }
@@ -206,14 +189,13 @@ CBFresponsee MPS_writeCOLUMNS(FILE *pFile, const CBFdata data)
     {
       if ( curobja < data.objannz && data.objasubj[objaidx[curobja]] == j )
       {
-        if (fprintf(pFile, "    x%-8lli %-9s %.16lg\n", j, "obj", data.objaval[objaidx[curobja]]) <= 0)
-          res = CBF_RES_ERR;
+        CBF_dtoa(data.objaval[objaidx[curobja]], val);
+        res = MPS_writeDATA(pFile, "", "x", j, "obj", -1, val);
         ++curobja;
       }
       else
       {
-        if (fprintf(pFile, "    x%-8lli %-9s %.16lg\n", j, "obj", 0.0) <= 0)
-          res = CBF_RES_ERR;
+        res = MPS_writeDATA(pFile, "", "x", j, "obj", -1, "0");
       }
     }
   }
@@ -221,7 +203,7 @@ CBFresponsee MPS_writeCOLUMNS(FILE *pFile, const CBFdata data)
   // Close integer mark if still open
   if ( res==CBF_RES_OK ) {
     if (isintegermark) {
-      if (fprintf(pFile, "    MARK%04lli  %-24s %s\n", curintmark, "'MARKER'", "'INTEND'") <= 0)
+      if (CBF_streamprintf(pFile, "    MARK%04lli  %-24s %s\n", curintmark, "'MARKER'", "'INTEND'") <= 0)
         res = CBF_RES_ERR;
 
       isintegermark = 0;
@@ -236,8 +218,7 @@ CBFresponsee MPS_writeCOLUMNS(FILE *pFile, const CBFdata data)
     case CBF_CONE_QUAD:
     case CBF_CONE_RQUAD:
       for (j=0; j<data.mapstackdim[i] && res==CBF_RES_OK; ++j) {
-        if (fprintf(pFile, "    xg%-7lli g%-8lli %.16lg\n", curmap, curmap, -1.0) <= 0)
-          res = CBF_RES_ERR;
+        res = MPS_writeDATA(pFile, "", "xg", curmap, "g", curmap, "-1");
         ++curmap;
       }
       break;
@@ -247,13 +228,13 @@ CBFresponsee MPS_writeCOLUMNS(FILE *pFile, const CBFdata data)
     }
   }
 
-  free(aidx);
+  CBF_freeindex(&index);
   free(intidx);
 
   return res;
 }
 
-static CBFresponsee MPS_writeCOLUMNS_controlINTEGERMARK(FILE *pFile, const CBFdata data, long long int xID,
+static CBFresponsee MPS_writeCOLUMNS_controlINTEGERMARK(CBFstream *pFile, const CBFdata data, long long int xID,
                                                         const long long int *intidx,
                                                         long long int       *curint,
                                                         long long int       *curintmark,
@@ -269,7 +250,7 @@ static CBFresponsee MPS_writeCOLUMNS_controlINTEGERMARK(FILE *pFile, const CBFda
 
     if ( res==CBF_RES_OK ) {
       if (!*isintegermark && data.intvar[intidx[*curint]] == xID) {
-        if (fprintf(pFile, "    MARK%04lli  %-24s %s\n", *curintmark, "'MARKER'", "'INTORG'") <= 0)
+        if (CBF_streamprintf(pFile, "    MARK%04lli  %-24s %s\n", *curintmark, "'MARKER'", "'INTORG'") <= 0)
           res = CBF_RES_ERR;
 
         *isintegermark = 1;
@@ -279,7 +260,7 @@ static CBFresponsee MPS_writeCOLUMNS_controlINTEGERMARK(FILE *pFile, const CBFda
 
     if ( res==CBF_RES_OK ) {
       if (*isintegermark && data.intvar[intidx[*curint]] != xID) {
-        if (fprintf(pFile, "    MARK%04lli  %-24s %s\n", *curintmark, "'MARKER'", "'INTEND'") <= 0)
+        if (CBF_streamprintf(pFile, "    MARK%04lli  %-24s %s\n", *curintmark, "'MARKER'", "'INTEND'") <= 0)
           res = CBF_RES_ERR;
 
         *isintegermark = 0;
@@ -291,38 +272,42 @@ static CBFresponsee MPS_writeCOLUMNS_controlINTEGERMARK(FILE *pFile, const CBFda
   return res;
 }
 
-CBFresponsee MPS_writeRHS(FILE *pFile, const CBFdata data)
+CBFresponsee MPS_writeRHS(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i;
+  char val[CBF_DTOA_BUFSIZE];
 
   if ( data.objbval != 0.0 || data.bnnz >= 1 )
   {
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "RHS\n") <= 0)
+      if (CBF_streamprintf(pFile, "RHS\n") <= 0)
         res = CBF_RES_ERR;
 
-    if (res == CBF_RES_OK)
-      if (data.objbval != 0.0)
-        if (fprintf(pFile, "    %-9s %-9s %.16lg\n", "BVEC", "obj", -data.objbval) <= 0)
-          res = CBF_RES_ERR;
+    if (res == CBF_RES_OK) {
+      if (data.objbval != 0.0) {
+        CBF_dtoa(-data.objbval, val);
+        res = MPS_writeDATA(pFile, "", "BVEC", -1, "obj", -1, val);
+      }
+    }
 
-    for (i=0; i<data.bnnz && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "    %-9s g%-8lli %.16lg\n", "BVEC", data.bsubi[i], -data.bval[i]) <= 0)
-        res = CBF_RES_ERR;
+    for (i=0; i<data.bnnz && res==CBF_RES_OK; ++i) {
+      CBF_dtoa(-data.bval[i], val);
+      res = MPS_writeDATA(pFile, "", "BVEC", -1, "g", data.bsubi[i], val);
+    }
   }
 
   return res;
 }
 
-CBFresponsee MPS_writeBOUNDS(FILE *pFile, const CBFdata data)
+CBFresponsee MPS_writeBOUNDS(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i, j, curvar = 0, curmap = 0, stackidx = 0;
   const char *domain1, *domain2;
 
   if (res == CBF_RES_OK)
-    if (fprintf(pFile, "BOUNDS\n") <= 0)
+    if (CBF_streamprintf(pFile, "BOUNDS\n") <= 0)
       res = CBF_RES_ERR;
 
   // Bounds of variables
@@ -337,13 +322,12 @@ CBFresponsee MPS_writeBOUNDS(FILE *pFile, const CBFdata data)
     case CBF_CONE_ZERO:
       stackidx = 0;     domain1 = NULL; domain2 = "FX";  break;
     case CBF_CONE_QUAD:
-      if (fprintf(pFile, " %s %-9s x%-8lli\n", "PL", "DOMAIN", curvar) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, "PL", "DOMAIN", -1, "x", curvar, NULL);
       stackidx = 1;     domain1 = "FR"; domain2 = NULL;  break;
     case CBF_CONE_RQUAD:
-      if (fprintf(pFile, " %s %-9s x%-8lli\n"
-                         " %s %-9s x%-8lli\n", "PL", "DOMAIN", curvar, "PL", "DOMAIN", curvar+1) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, "PL", "DOMAIN", -1, "x", curvar, NULL);
+      if (res == CBF_RES_OK)
+        res = MPS_writeDATA(pFile, "PL", "DOMAIN", -1, "x", curvar+1, NULL);
       stackidx = 2;     domain1 = "FR"; domain2 = NULL;  break;
     default:
       res = CBF_RES_ERR;
@@ -353,11 +337,9 @@ CBFresponsee MPS_writeBOUNDS(FILE *pFile, const CBFdata data)
     curvar += stackidx;
     for (j=stackidx; j<data.varstackdim[i] && res==CBF_RES_OK; ++j) {
       if (domain1 != NULL)
-        if (fprintf(pFile, " %s %-9s x%-8lli\n", domain1, "DOMAIN", curvar) <= 0)
-          res = CBF_RES_ERR;
-      if (domain2 != NULL)
-        if (fprintf(pFile, " %s %-9s x%-8lli %.16lg\n", domain2, "DOMAIN", curvar, 0.0) <= 0)
-          res = CBF_RES_ERR;
+        res = MPS_writeDATA(pFile, domain1, "DOMAIN", -1, "x", curvar, NULL);
+      if (domain2 != NULL && res == CBF_RES_OK)
+        res = MPS_writeDATA(pFile, domain2, "DOMAIN", -1, "x", curvar, "0");
       ++curvar;
     }
   }
@@ -367,14 +349,13 @@ CBFresponsee MPS_writeBOUNDS(FILE *pFile, const CBFdata data)
     switch(data.mapstackdomain[i])
     {
     case CBF_CONE_QUAD:
-      if (fprintf(pFile, " %s %-9s xg%-7lli\n", "PL", "DOMAIN", curmap) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, "PL", "DOMAIN", -1, "xg", curmap, NULL);
       stackidx = 1;     domain1 = "FR";  break;
       break;
     case CBF_CONE_RQUAD:
-      if (fprintf(pFile, " %s %-9s xg%-7lli\n"
-                         " %s %-9s xg%-7lli\n", "PL", "DOMAIN", curmap, "PL", "DOMAIN", curmap+1) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, "PL", "DOMAIN", -1, "xg", curmap, NULL);
+      if (res == CBF_RES_OK)
+        res = MPS_writeDATA(pFile, "PL", "DOMAIN", -1, "xg", curmap+1, NULL);
       stackidx = 2;     domain1 = "FR";  break;
       break;
     default:
@@ -384,8 +365,7 @@ CBFresponsee MPS_writeBOUNDS(FILE *pFile, const CBFdata data)
 
     curmap += stackidx;
     for (j=stackidx; j<data.mapstackdim[i] && res==CBF_RES_OK; ++j) {
-      if (fprintf(pFile, " %s %-9s xg%-7lli\n", domain1, "DOMAIN", curmap) <= 0)
-        res = CBF_RES_ERR;
+      res = MPS_writeDATA(pFile, domain1, "DOMAIN", -1, "xg", curmap, NULL);
       ++curmap;
     }
   }
@@ -393,11 +373,66 @@ CBFresponsee MPS_writeBOUNDS(FILE *pFile, const CBFdata data)
   return res;
 }
 
-CBFresponsee MPS_writeENDATA(FILE *pFile, const CBFdata data)
+CBFresponsee MPS_writeDATA(CBFstream *pFile, const char *type, const char *name1, long long int idx1,
+                                                            const char *name2, long long int idx2,
+                                                            const char *val)
+{
+  size_t len;
+  char *p;
+
+  p = CBF_streamreserve(pFile, CBF_MAX_LINE);
+  if (!p)
+    return CBF_RES_ERR;
+
+  // Type in columns 2-3, name in 5-12, name in 15-22, value from 25
+  len = strlen(type);
+  *p++ = ' ';
+  memcpy(p, type, len);
+  p += len;
+  for (; len < 3; ++len)
+    *p++ = ' ';
+
+  p = MPS_putfield(p, name1, idx1, name2 ? MPS_NAME_WIDTH : 0);
+
+  if (name2) {
+    *p++ = ' ';
+    p = MPS_putfield(p, name2, idx2, MPS_NAME_WIDTH);
+  }
+
+  if (val) {
+    len = strlen(val);
+    *p++ = ' ';
+    memcpy(p, val, len);
+    p += len;
+  }
+
+  *p++ = '\n';
+  CBF_streamcommit(pFile, p);
+  return CBF_RES_OK;
+}
+
+static char * MPS_putfield(char *p, const char *name, long long int idx, int width)
+{
+  size_t len = strlen(name);
+  char *begin = p;
+
+  memcpy(p, name, len);
+  p += len;
+
+  if (idx >= 0)
+    p += CBF_lltoa(idx, p);
+
+  while (p - begin < width)
+    *p++ = ' ';
+
+  return p;
+}
+
+CBFresponsee MPS_writeENDATA(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
 
-  if (fprintf(pFile, "ENDATA\n") <= 0)
+  if (CBF_streamprintf(pFile, "ENDATA\n") <= 0)
     res = CBF_RES_ERR;
 
   return res;
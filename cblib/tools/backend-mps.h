@@ -21,27 +21,41 @@
 
 #include "cbf-data.h"
 #include "programmingstyle.h"
-#include <stdio.h>      // Unfortunately, no portable forward declaration of FILE
+#include "cbf-stream.h"
+
+// Width of name fields
+#define MPS_NAME_WIDTH  9
 
 CBFresponsee
-  MPS_writeNAME(FILE *pFile, const CBFdata data);
+  MPS_writeNAME(CBFstream *pFile, const CBFdata data);
 
 CBFresponsee
-  MPS_writeOBJSENSE(FILE *pFile, const CBFdata data);
+  MPS_writeOBJSENSE(CBFstream *pFile, const CBFdata data);
 
 CBFresponsee
-  MPS_writeROWS(FILE *pFile, const CBFdata data);
+  MPS_writeROWS(CBFstream *pFile, const CBFdata data);
 
 CBFresponsee
-  MPS_writeCOLUMNS(FILE *pFile, const CBFdata data);
+  MPS_writeCOLUMNS(CBFstream *pFile, const CBFdata data);
 
 CBFresponsee
-  MPS_writeRHS(FILE *pFile, const CBFdata data);
+  MPS_writeRHS(CBFstream *pFile, const CBFdata data);
 
 CBFresponsee
-  MPS_writeBOUNDS(FILE *pFile, const CBFdata data);
+  MPS_writeBOUNDS(CBFstream *pFile, const CBFdata data);
 
 CBFresponsee
-  MPS_writeENDATA(FILE *pFile, const CBFdata data);
+  MPS_writeENDATA(CBFstream *pFile, const CBFdata data);
+
+/*
+ * Writes a line of the data sections: a type (possibly empty), a name and,
+ * unless name2 is NULL, a second name, each with its index appended unless
+ * negative, and val unless NULL. Names are aligned to the fixed columns of
+ * the format.
+ */
+CBFresponsee
+  MPS_writeDATA(CBFstream *pFile, const char *type, const char *name1, long long int idx1,
+                                                    const char *name2, long long int idx2,
+                                                    const char *val);
 
 #endif
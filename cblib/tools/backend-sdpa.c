@@ -17,34 +17,46 @@
 // 3. This notice may not be removed or altered from any source distribution.
 
 #include "backend-sdpa.h"
+#include "cbf-stream.h"
+#include "cbf-dtoa.h"
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static CBFresponsee
   write(const char *file, const CBFdata data);
 
 static CBFresponsee
-  writeVAR(FILE *pFile, const CBFdata data);
+  writebuffer(CBFbuffer *buf, const CBFdata data);
 
 static CBFresponsee
-  writeBLOCKS(FILE *pFile, const CBFdata data);
+  writefile(const char *file, CBFbuffer *buf, const CBFdata data);
 
 static CBFresponsee
-  writeMAPZERO(FILE *pFile, const CBFdata data);
+  writeVAR(CBFstream *pFile, const CBFdata data);
 
 static CBFresponsee
-  writePSDCON(FILE *pFile, const CBFdata data);
+  writeBLOCKS(CBFstream *pFile, const CBFdata data);
 
 static CBFresponsee
-  writeINTVAR(FILE *pFile, const CBFdata data);
+  writeMAPZERO(CBFstream *pFile, const CBFdata data);
+
+static CBFresponsee
+  writePSDCON(CBFstream *pFile, const CBFdata data);
+
+static CBFresponsee
+  writeINTVAR(CBFstream *pFile, const CBFdata data);
+
+static CBFresponsee
+  writeENTRY(CBFstream *pFile, const char *head, const long long int *sub, int subnum, const double *val, char end);
 
 
 // -------------------------------------
 // Global variable
 // -------------------------------------
 
-CBFbackend const backend_sdpa = { "sdpa", "dat-s", write };
+CBFbackend const backend_sdpa = { "sdpa", "dat-s", write, writebuffer };
 
 
 // -------------------------------------
@@ -52,38 +64,47 @@ CBFbackend const backend_sdpa = { "sdpa", "dat-s", write };
 // -------------------------------------
 
 static CBFresponsee write(const char *file, const CBFdata data) {
+  return writefile(file, NULL, data);
+}
+
+static CBFresponsee writebuffer(CBFbuffer *buf, const CBFdata data) {
+  return writefile(NULL, buf, data);
+}
+
+// Writes to file, or to buf if file is NULL
+static CBFresponsee writefile(const char *file, CBFbuffer *buf, const CBFdata data) {
   CBFresponsee res = CBF_RES_OK;
   long long int i;
-  FILE *pFile = NULL;
+  CBFstream *pFile = NULL;
 
   if (data.mapnum >= 1) {
-    printf("Scalar map constraints are not supported in the selected output file format.\n");
+    fprintf(CBF_messagestream(), "Scalar map constraints are not supported in the selected output file format.\n");
     return CBF_RES_ERR;
   }
 
   for (i=0; i<data.varstacknum; ++i) {
     if (data.varstackdomain[i] != CBF_CONE_FREE) {
-      printf("Non-free scalar variables are not supported in the selected output file format.\n");
+      fprintf(CBF_messagestream(), "Non-free scalar variables are not supported in the selected output file format.\n");
       return CBF_RES_ERR;
     }
   }
 
   if (data.objsense == CBF_OBJ_MAXIMIZE) {
-    printf("Maximization problems are not supported in the selected output file format.\n");
+    fprintf(CBF_messagestream(), "Maximization problems are not supported in the selected output file format.\n");
     return CBF_RES_ERR;
   }
 
   if (data.objbval != 0.0) {
-    printf("The non-zero constant in the objective function is not supported in the selected output file format.\n");
+    fprintf(CBF_messagestream(), "The non-zero constant in the objective function is not supported in the selected output file format.\n");
     return CBF_RES_ERR;
   }
 
   if (data.psdvarnum >= 1) {
-    printf("Positive semidefinite variables are not supported in the selected output file format.\n");
+    fprintf(CBF_messagestream(), "Positive semidefinite variables are not supported in the selected output file format.\n");
     return CBF_RES_ERR;
   }
 
-  pFile = fopen(file, "wt");
+  pFile = file ? CBF_openstream(file, "w") : CBF_openbufferstream(buf);
   if (!pFile) {
     return CBF_RES_ERR;
   }
@@ -103,45 +124,48 @@ static CBFresponsee write(const char *file, const CBFdata data) {
   if (res == CBF_RES_OK)
     res = writeINTVAR(pFile, data);
 
-  fclose(pFile);
+  if (CBF_closestream(pFile) != CBF_RES_OK)
+    res = CBF_RES_ERR;
+
   return res;
 }
 
-static CBFresponsee writeVAR(FILE *pFile, const CBFdata data)
+static CBFresponsee writeVAR(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
 
-  if (fprintf(pFile, "%lli\n", data.varnum) <= 0)
+  if (CBF_streamprintf(pFile, "%lli\n", data.varnum) <= 0)
     res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee writeBLOCKS(FILE *pFile, const CBFdata data)
+static CBFresponsee writeBLOCKS(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
+  long long int i, dim;
 
-  if (fprintf(pFile, "%i\n", data.psdmapnum) <= 0)
+  if (CBF_streamprintf(pFile, "%i\n", data.psdmapnum) <= 0)
     res = CBF_RES_ERR;
 
-  for (i=0; i<data.psdmapnum && res==CBF_RES_OK; ++i)
-    if (fprintf(pFile, "%i ", data.psdmapdim[i]) <= 0)
-      res = CBF_RES_ERR;
+  for (i=0; i<data.psdmapnum && res==CBF_RES_OK; ++i) {
+    dim = data.psdmapdim[i];
+    res = writeENTRY(pFile, "", &dim, 1, NULL, ' ');
+  }
 
   if (res == CBF_RES_OK)
-    if (fprintf(pFile, "\n") <= 0)
+    if (CBF_streamprintf(pFile, "\n") <= 0)
       res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee writeMAPZERO(FILE *pFile, const CBFdata data)
+static CBFresponsee writeMAPZERO(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i;
   double *c = NULL;
-  double sign = 1.0;
+  double sign = 1.0, val;
 
   if (data.varnum >= 1)
   {
@@ -153,12 +177,13 @@ static CBFresponsee writeMAPZERO(FILE *pFile, const CBFdata data)
     for (i=0; i<data.objannz && res==CBF_RES_OK; ++i)
       c[data.objasubj[i]] = data.objaval[i];
 
-    for (i=0; i<data.varnum && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "%.16lg ", sign*c[i]) <= 0)
-        res = CBF_RES_ERR;
+    for (i=0; i<data.varnum && res==CBF_RES_OK; ++i) {
+      val = sign*c[i];
+      res = writeENTRY(pFile, "", NULL, 0, &val, ' ');
+    }
 
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "\n") <= 0)
+      if (CBF_streamprintf(pFile, "\n") <= 0)
         res = CBF_RES_ERR;
 
     free(c);
@@ -167,23 +192,27 @@ static CBFresponsee writeMAPZERO(FILE *pFile, const CBFdata data)
   return res;
 }
 
-static CBFresponsee writePSDCON(FILE *pFile, const CBFdata data)
+static CBFresponsee writePSDCON(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
+  long long int i, sub[4];
+  double val;
 
-  for (i=0; i<data.dnnz && res==CBF_RES_OK; ++i)
-    if (fprintf(pFile, "%lli %i %i %i %.16lg\n", 0LL, data.dsubi[i]+1, data.dsubk[i]+1, data.dsubl[i]+1, -data.dval[i]) <= 0)
-      res = CBF_RES_ERR;
+  for (i=0; i<data.dnnz && res==CBF_RES_OK; ++i) {
+    sub[0] = 0;  sub[1] = data.dsubi[i]+1;  sub[2] = data.dsubk[i]+1;  sub[3] = data.dsubl[i]+1;
+    val = -data.dval[i];
+    res = writeENTRY(pFile, "", sub, 4, &val, '\n');
+  }
 
-  for (i=0; i<data.hnnz && res==CBF_RES_OK; ++i)
-    if (fprintf(pFile, "%lli %i %i %i %.16lg\n", data.hsubj[i]+1, data.hsubi[i]+1, data.hsubk[i]+1, data.hsubl[i]+1, data.hval[i]) <= 0)
-      res = CBF_RES_ERR;
+  for (i=0; i<data.hnnz && res==CBF_RES_OK; ++i) {
+    sub[0] = data.hsubj[i]+1;  sub[1] = data.hsubi[i]+1;  sub[2] = data.hsubk[i]+1;  sub[3] = data.hsubl[i]+1;
+    res = writeENTRY(pFile, "", sub, 4, &data.hval[i], '\n');
+  }
 
   return res;
 }
 
-static CBFresponsee writeINTVAR(FILE *pFile, const CBFdata data)
+static CBFresponsee writeINTVAR(CBFstream *pFile, const CBFdata data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i;
@@ -191,14 +220,44 @@ static CBFresponsee writeINTVAR(FILE *pFile, const CBFdata data)
   if (data.intvarnum >= 1)
   {
     if (res == CBF_RES_OK)
-      if (fprintf(pFile, "*INTEGER*\n") <= 0)
+      if (CBF_streamprintf(pFile, "*INTEGER*\n") <= 0)
         res = CBF_RES_ERR;
 
     for (i=0; i<data.intvarnum && res==CBF_RES_OK; ++i)
-      if (fprintf(pFile, "*%lli\n", data.intvar[i]) <= 0)
-        res = CBF_RES_ERR;
+      res = writeENTRY(pFile, "*", &data.intvar[i], 1, NULL, '\n');
   }
 
   return res;
 }
 
+// Writes head and a list of indices, followed by a value unless val is NULL, and then end
+static CBFresponsee writeENTRY(CBFstream *pFile, const char *head, const long long int *sub, int subnum, const double *val, char end)
+{
+  size_t len = strlen(head);
+  char *p;
+  int k;
+
+  p = CBF_streamreserve(pFile, CBF_MAX_LINE);
+  if (!p)
+    return CBF_RES_ERR;
+
+  memcpy(p, head, len);
+  p += len;
+
+  for (k=0; k<subnum; ++k) {
+    if (k >= 1)
+      *p++ = ' ';
+    p += CBF_lltoa(sub[k], p);
+  }
+
+  if (val) {
+    if (subnum >= 1)
+      *p++ = ' ';
+    p += CBF_dtoa(*val, p);
+  }
+
+  *p++ = end;
+  CBF_streamcommit(pFile, p);
+  return CBF_RES_OK;
+}
+
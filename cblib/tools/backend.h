@@ -20,6 +20,7 @@
 #define CBF_BACKEND_H
 
 #include "cbf-data.h"
+#include "cbf-stream.h"
 #include "programmingstyle.h"
 
 typedef struct CBFbackend_struct {
@@ -28,6 +29,9 @@ typedef struct CBFbackend_struct {
   const char *format;
   CBFresponsee (*write)(const char *file, const CBFdata data);
 
+  // Appends the file to buf instead (NULL if not supported)
+  CBFresponsee (*writebuffer)(CBFbuffer *buf, const CBFdata data);
+
 } CBFbackend;
 
 #endif
@@ -0,0 +1,113 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef CBF_CBF_BINARY_H
+#define CBF_CBF_BINARY_H
+
+#include "cbf-data.h"
+
+/*
+ * Binary CBF container (cbfb). A fixed header of counts is followed by the
+ * arrays of CBFdata stored as raw columns, each starting at a multiple of
+ * CBF_BINARY_ALIGN from the beginning of the file. Numbers are stored in
+ * the byte order of the writing host (little-endian on all supported
+ * platforms), and readers reject files written with another byte order, so
+ * a file can be memory mapped and used in place without any parsing.
+ */
+#define CBF_BINARY_MAGIC      "CBFBIN\r\n"
+#define CBF_BINARY_LAYOUT     1
+#define CBF_BINARY_BYTEORDER  0x01020304u
+#define CBF_BINARY_ALIGN      64
+
+typedef enum CBFbinarycolumn_enum {
+  CBF_COL_MAPSTACKDIM = 0,
+  CBF_COL_MAPSTACKDOMAIN,
+  CBF_COL_VARSTACKDIM,
+  CBF_COL_VARSTACKDOMAIN,
+  CBF_COL_INTVAR,
+  CBF_COL_PSDMAPDIM,
+  CBF_COL_PSDVARDIM,
+
+  CBF_COL_OBJFSUBJ,
+  CBF_COL_OBJFSUBK,
+  CBF_COL_OBJFSUBL,
+  CBF_COL_OBJFVAL,
+
+  CBF_COL_OBJASUBJ,
+  CBF_COL_OBJAVAL,
+
+  CBF_COL_FSUBI,
+  CBF_COL_FSUBJ,
+  CBF_COL_FSUBK,
+  CBF_COL_FSUBL,
+  CBF_COL_FVAL,
+
+  CBF_COL_ASUBI,
+  CBF_COL_ASUBJ,
+  CBF_COL_AVAL,
+
+  CBF_COL_BSUBI,
+  CBF_COL_BVAL,
+
+  CBF_COL_HSUBI,
+  CBF_COL_HSUBJ,
+  CBF_COL_HSUBK,
+  CBF_COL_HSUBL,
+  CBF_COL_HVAL,
+
+  CBF_COL_DSUBI,
+  CBF_COL_DSUBK,
+  CBF_COL_DSUBL,
+  CBF_COL_DVAL,
+
+  CBF_COL_END
+} CBFbinarycolumne;
+
+typedef struct CBFbinaryheader_struct {
+
+  char          magic[8];
+  unsigned int  byteorder;
+  unsigned int  layout;
+
+  long long int ver;
+  long long int objsense;
+
+  long long int mapnum;
+  long long int mapstacknum;
+  long long int varnum;
+  long long int varstacknum;
+  long long int intvarnum;
+  long long int psdmapnum;
+  long long int psdvarnum;
+
+  long long int objfnnz;
+  long long int objannz;
+  double        objbval;
+
+  long long int fnnz;
+  long long int annz;
+  long long int bnnz;
+  long long int hnnz;
+  long long int dnnz;
+
+  // File offset of each column (0 for empty columns)
+  long long int offset[CBF_COL_END];
+
+} CBFbinaryheader;
+
+#endif
@@ -48,6 +48,25 @@ typedef enum CBFscalarcone_enum {
 } CBFscalarconee;
 
 
+// Coordinate blocks known to be sorted. FCOORD, ACOORD, BCOORD, HCOORD and
+// DCOORD are sorted row-major (by their indices from left to right), ACOL is
+// ACOORD sorted by variable and then map, OBJACOORD is sorted by variable and
+// INT is ascending. A cleared flag means the order is unknown.
+typedef enum CBFsorted_enum {
+  CBF_SORTED_NONE = 0,
+  CBF_SORTED_ALL = 255,
+
+  CBF_SORTED_OBJA = 1,
+  CBF_SORTED_F = 2,
+  CBF_SORTED_A = 4,
+  CBF_SORTED_B = 8,
+  CBF_SORTED_H = 16,
+  CBF_SORTED_D = 32,
+  CBF_SORTED_ACOL = 64,
+  CBF_SORTED_INT = 128
+} CBFsortede;
+
+
 typedef struct CBFdata_struct {
 
   //
@@ -129,6 +148,11 @@ typedef struct CBFdata_struct {
   int           *dsubl;
   double        *dval;
 
+  //
+  // Coordinate blocks known to be sorted (bitwise or of CBFsortede)
+  //
+  int            sorted;
+
 } CBFdata;
 
 #endif
@@ -0,0 +1,41 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef CBF_CBF_DTOA_H
+#define CBF_CBF_DTOA_H
+
+#include "programmingstyle.h"
+
+// Size of a buffer large enough for any output of CBF_dtoa and CBF_lltoa
+#define CBF_DTOA_BUFSIZE 32
+
+/*
+ * Writes the shortest decimal representation of val that reads back as
+ * exactly val, and of those the one closest to val, to buf. The layout
+ * follows the %.16lg conversion of printf (e.g. "1", "-0.25", "1e-05",
+ * "6.02214076e+23", "inf"). Returns the number of characters written,
+ * excluding the terminating null character.
+ */
+int
+CBF_dtoa(double val, char *buf);
+
+// As CBF_dtoa for the %lli conversion of printf
+int
+CBF_lltoa(long long int val, char *buf);
+
+#endif
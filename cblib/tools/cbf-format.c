@@ -19,15 +19,15 @@
 #include "cbf-format.h"
 #include <string.h>
 
+static int
+  CBF_inorder(long long int i0, long long int j0, long long int k0, long long int l0,
+              long long int i1, long long int j1, long long int k1, long long int l1);
+
 
 // -------------------------------------
 // Global variable
 // -------------------------------------
 
-// File format buffers
-char CBF_LINE_BUFFER[CBF_MAX_LINE];
-char CBF_NAME_BUFFER[CBF_MAX_NAME];
-
 // Names of the scalar cones
 const char * CBF_CONENAM_FREE = "F";
 const char * CBF_CONENAM_ZERO = "L=";
@@ -127,3 +127,94 @@ CBFresponsee CBF_strtoobjsense(const char *str, CBFobjsensee *objsense)
 
   return CBF_RES_OK;
 }
+
+int CBF_findsorted(const CBFdata *data, int blocks)
+{
+  long long int n;
+
+  for (n = 1; n < data->objannz && (blocks & CBF_SORTED_OBJA); ++n)
+    if (data->objasubj[n-1] > data->objasubj[n])
+      blocks &= ~CBF_SORTED_OBJA;
+
+  for (n = 1; n < data->fnnz && (blocks & CBF_SORTED_F); ++n)
+    if (!CBF_inorder(data->fsubi[n-1], data->fsubj[n-1], data->fsubk[n-1], data->fsubl[n-1],
+                     data->fsubi[n],   data->fsubj[n],   data->fsubk[n],   data->fsubl[n]))
+      blocks &= ~CBF_SORTED_F;
+
+  for (n = 1; n < data->annz && (blocks & CBF_SORTED_A); ++n)
+    if (!CBF_inorder(data->asubi[n-1], data->asubj[n-1], 0, 0, data->asubi[n], data->asubj[n], 0, 0))
+      blocks &= ~CBF_SORTED_A;
+
+  for (n = 1; n < data->annz && (blocks & CBF_SORTED_ACOL); ++n)
+    if (!CBF_inorder(data->asubj[n-1], data->asubi[n-1], 0, 0, data->asubj[n], data->asubi[n], 0, 0))
+      blocks &= ~CBF_SORTED_ACOL;
+
+  for (n = 1; n < data->bnnz && (blocks & CBF_SORTED_B); ++n)
+    if (data->bsubi[n-1] > data->bsubi[n])
+      blocks &= ~CBF_SORTED_B;
+
+  for (n = 1; n < data->hnnz && (blocks & CBF_SORTED_H); ++n)
+    if (!CBF_inorder(data->hsubi[n-1], data->hsubj[n-1], data->hsubk[n-1], data->hsubl[n-1],
+                     data->hsubi[n],   data->hsubj[n],   data->hsubk[n],   data->hsubl[n]))
+      blocks &= ~CBF_SORTED_H;
+
+  for (n = 1; n < data->dnnz && (blocks & CBF_SORTED_D); ++n)
+    if (!CBF_inorder(data->dsubi[n-1], data->dsubk[n-1], data->dsubl[n-1], 0, data->dsubi[n], data->dsubk[n], data->dsubl[n], 0))
+      blocks &= ~CBF_SORTED_D;
+
+  for (n = 1; n < data->intvarnum && (blocks & CBF_SORTED_INT); ++n)
+    if (data->intvar[n-1] > data->intvar[n])
+      blocks &= ~CBF_SORTED_INT;
+
+  return blocks;
+}
+
+int CBF_findsortedappend(const CBFdata *data, const CBFdata *delta, int blocks)
+{
+  long long int n = data->objannz - 1;
+  if (n >= 0 && delta->objannz >= 1 && data->objasubj[n] > delta->objasubj[0])
+    blocks &= ~CBF_SORTED_OBJA;
+
+  n = data->fnnz - 1;
+  if (n >= 0 && delta->fnnz >= 1 && !CBF_inorder(data->fsubi[n], data->fsubj[n], data->fsubk[n], data->fsubl[n],
+                                                 delta->fsubi[0], delta->fsubj[0], delta->fsubk[0], delta->fsubl[0]))
+    blocks &= ~CBF_SORTED_F;
+
+  n = data->annz - 1;
+  if (n >= 0 && delta->annz >= 1 && !CBF_inorder(data->asubi[n], data->asubj[n], 0, 0, delta->asubi[0], delta->asubj[0], 0, 0))
+    blocks &= ~CBF_SORTED_A;
+
+  if (n >= 0 && delta->annz >= 1 && !CBF_inorder(data->asubj[n], data->asubi[n], 0, 0, delta->asubj[0], delta->asubi[0], 0, 0))
+    blocks &= ~CBF_SORTED_ACOL;
+
+  n = data->bnnz - 1;
+  if (n >= 0 && delta->bnnz >= 1 && data->bsubi[n] > delta->bsubi[0])
+    blocks &= ~CBF_SORTED_B;
+
+  n = data->hnnz - 1;
+  if (n >= 0 && delta->hnnz >= 1 && !CBF_inorder(data->hsubi[n], data->hsubj[n], data->hsubk[n], data->hsubl[n],
+                                                 delta->hsubi[0], delta->hsubj[0], delta->hsubk[0], delta->hsubl[0]))
+    blocks &= ~CBF_SORTED_H;
+
+  n = data->dnnz - 1;
+  if (n >= 0 && delta->dnnz >= 1 && !CBF_inorder(data->dsubi[n], data->dsubk[n], data->dsubl[n], 0, delta->dsubi[0], delta->dsubk[0], delta->dsubl[0], 0))
+    blocks &= ~CBF_SORTED_D;
+
+  return blocks;
+}
+
+// Lexicographic (i0, j0, k0, l0) <= (i1, j1, k1, l1)
+static int CBF_inorder(long long int i0, long long int j0, long long int k0, long long int l0,
+                       long long int i1, long long int j1, long long int k1, long long int l1)
+{
+  if (i0 != i1)
+    return i0 < i1;
+
+  if (j0 != j1)
+    return j0 < j1;
+
+  if (k0 != k1)
+    return k0 < k1;
+
+  return l0 <= l1;
+}
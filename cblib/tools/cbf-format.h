@@ -27,14 +27,21 @@ CBFresponsee CBF_strtocone(const char *str, CBFscalarconee *cone);
 CBFresponsee CBF_objsensetostr(CBFobjsensee cone, const char **str);
 CBFresponsee CBF_strtoobjsense(const char *str, CBFobjsensee *cone);
 
+// Returns those of the coordinate blocks (CBFsortede) that are sorted
+int CBF_findsorted(const CBFdata *data, int blocks);
+
+// Returns those of the sorted coordinate blocks (CBFsortede) of data and delta
+// that stay sorted when delta is appended, comparing only where they meet
+int CBF_findsortedappend(const CBFdata *data, const CBFdata *delta, int blocks);
+
 // Use CBF_NAME_FORMAT instead of %s when parsing lines,
 // to avoid buffer overflow.
 #define MACRO_STR_EXPAND(tok) #tok
 #define MACRO_STR(tok) MACRO_STR_EXPAND(tok)
 #define CBF_NAME_FORMAT "%" MACRO_STR(CBF_MAX_NAME) "s"
 
-extern char CBF_LINE_BUFFER[CBF_MAX_LINE];
-extern char CBF_NAME_BUFFER[CBF_MAX_NAME];
+// Appended to the name of a CBF file to get the name of its section index
+#define CBF_SECTION_EXTENSION ".idx"
 
 extern const char * CBF_CONENAM_FREE;
 extern const char * CBF_CONENAM_ZERO;
@@ -17,9 +17,127 @@
 // 3. This notice may not be removed or altered from any source distribution.
 
 #include "cbf-helper.h"
+#include "cbf-thread.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <stddef.h>
+#include <string.h>
+
+// Bits sorted per pass of CBF_radixsort
+#define CBF_RADIX_BITS  11
+
+// Fewest entries per thread of a parallel sort, so small inputs are sorted serially
+#define CBF_SORT_CHUNK  (1 << 18)
+
+// Bits sorted per level of CBF_flagsort, and ranges short enough for insertion sort
+#define CBF_FLAG_BITS   8
+#define CBF_FLAG_SMALL  32
+
+/*
+ * A key of CBF_keysort, read from lval if not NULL and from ival otherwise,
+ * with values in [0, maxval].
+ */
+typedef struct CBFsortkey_struct {
+
+  const long long int *lval;
+  const int           *ival;
+  long long int        maxval;
+
+} CBFsortkey;
+
+// An array permuted by CBF_sortarrays along with the keys
+typedef struct CBFsortarray_struct {
+
+  void   *data;
+  size_t  size;
+
+} CBFsortarray;
+
+/*
+ * Entries [ibeg, iend) handled by one thread of CBF_keysort, CBF_radixsort
+ * and CBF_gather. The radix sort moves key and idx to keytmp and idxtmp,
+ * with count holding the digit histogram (and then output offsets) of the
+ * chunk.
+ */
+typedef struct CBFsortchunk_struct {
+
+  long long int ibeg;
+  long long int iend;
+
+  const CBFsortkey *keys;
+  int numkeys;
+
+  unsigned long long int *key;
+  unsigned long long int *keytmp;
+  const long long int *idx;
+  long long int *idxtmp;
+  long long int *count;
+  int shift;
+
+  void *dst;
+  const void *src;
+  size_t size;
+
+} CBFsortchunk;
+
+static CBFresponsee
+  CBF_sortarrays(long long int nnz, const CBFsortkey *keys, int numkeys, const CBFsortarray *arrays, int numarrays);
+
+static CBFresponsee
+  CBF_keysort(long long int nnz, const CBFsortkey *keys, int numkeys, long long int *idx);
+
+static CBFresponsee
+  CBF_keysort_inplace(long long int nnz, const CBFsortkey *keys, int numkeys, long long int *idx);
+
+static void
+  CBF_flagsort(long long int nnz, int keybits, unsigned long long int *key, int valbits, unsigned long long int *val);
+
+static CBFresponsee
+  CBF_permute(long long int nnz, long long int *perm, const CBFsortarray *arrays, int numarrays);
+
+static CBFresponsee
+  CBF_radixsort(long long int nnz, int keybits, unsigned long long int *key, long long int *idx, CBFsortchunk *chunks, int numchunks);
+
+static CBFresponsee
+  CBF_radixsort_parallel(long long int nnz, int keybits, unsigned long long int *key, long long int *idx, CBFsortchunk *chunks, int numchunks);
+
+static CBFresponsee
+  CBF_gather(long long int nnz, const long long int *idx, void *dst, const void *src, size_t size);
+
+static CBFsortchunk *
+  CBF_splitsort(long long int nnz, int *numchunks);
+
+static void
+  CBF_packkeys_task(void *chunk);
+
+static void
+  CBF_countdigits_task(void *chunk);
+
+static void
+  CBF_scatterdigits_task(void *chunk);
+
+static void
+  CBF_gather_task(void *chunk);
+
+static int
+  CBF_bitlength(long long int maxval);
+
+static CBFresponsee
+  CBF_buildrows(long long int nnz, const CBFsortkey *keys, int numkeys, int sorted, long long int numrows, long long int **ptr, long long int **idx);
+
+
+// -------------------------------------
+// Global variable
+// -------------------------------------
+
+// Sorts coordinates in place rather than through temporary arrays
+static int CBF_inplacesort = 0;
+
+
+// -------------------------------------
+// Function definitions
+// -------------------------------------
+
 /*
 
  * ------------------------------------------------
@@ -139,312 +257,601 @@ CBFresponsee CBF_bucketsort(long long int maxval, long long int nnz, const int *
   return res;
 }
 
+CBFresponsee CBF_indexsort(long long int nnz, const long long int *pval, long long int maxpval, const long long int *sval, long long int maxsval,
+    long long int *idx) {
+  CBFsortkey keys[] = { { pval, NULL, maxpval }, { sval, NULL, maxsval } };
+
+  if (nnz == 0)
+    return CBF_RES_OK;
+
+  return CBF_keysort(nnz, keys, sval ? 2 : 1, idx);
+}
+
+void CBF_setinplacesort(int inplace) {
+  CBF_inplacesort = inplace;
+}
+
 CBFresponsee CBF_coordinatesort(long long int *i, double *v, long long int nnz, long long int maxi) {
+  CBFsortkey keys[] = { { i, NULL, maxi } };
+  CBFsortarray arrays[] = { { i, sizeof(i[0]) }, { v, sizeof(v[0]) } };
+
+  return CBF_sortarrays(nnz, keys, 1, arrays, 2); // stable sort by i
+}
+
+CBFresponsee CBF_coordinatesort(long long int *i, long long int *j, double *v, long long int nnz, long long int maxi, long long int maxj) {
+  CBFsortkey keys[] = { { i, NULL, maxi }, { j, NULL, maxj } };
+  CBFsortarray arrays[] = { { i, sizeof(i[0]) }, { j, sizeof(j[0]) }, { v, sizeof(v[0]) } };
+
+  return CBF_sortarrays(nnz, keys, 2, arrays, 3); // stable sort by i, j
+}
+
+CBFresponsee CBF_coordinatesort(int *i, int *j, int *k, double *v, long long int nnz, long long int maxi, long long int maxj, long long int maxk) {
+  CBFsortkey keys[] = { { NULL, i, maxi }, { NULL, j, maxj }, { NULL, k, maxk } };
+  CBFsortarray arrays[] = { { i, sizeof(i[0]) }, { j, sizeof(j[0]) }, { k, sizeof(k[0]) }, { v, sizeof(v[0]) } };
+
+  return CBF_sortarrays(nnz, keys, 3, arrays, 4); // stable sort by i, j, k
+}
+
+CBFresponsee CBF_coordinatesort(long long int *i, int *j, int *k, int *l, double *v, long long int nnz, long long int maxi, long long int maxj,
+    long long int maxk, long long int maxl) {
+  CBFsortkey keys[] = { { i, NULL, maxi }, { NULL, j, maxj }, { NULL, k, maxk }, { NULL, l, maxl } };
+  CBFsortarray arrays[] = { { i, sizeof(i[0]) }, { j, sizeof(j[0]) }, { k, sizeof(k[0]) }, { l, sizeof(l[0]) }, { v, sizeof(v[0]) } };
+
+  return CBF_sortarrays(nnz, keys, 4, arrays, 5); // stable sort by i, j, k, l
+}
+
+CBFresponsee CBF_coordinatesort(int *i, long long int *j, int *k, int *l, double *v, long long int nnz, long long int maxi, long long int maxj,
+    long long int maxk, long long int maxl) {
+  CBFsortkey keys[] = { { NULL, i, maxi }, { j, NULL, maxj }, { NULL, k, maxk }, { NULL, l, maxl } };
+  CBFsortarray arrays[] = { { i, sizeof(i[0]) }, { j, sizeof(j[0]) }, { k, sizeof(k[0]) }, { l, sizeof(l[0]) }, { v, sizeof(v[0]) } };
+
+  return CBF_sortarrays(nnz, keys, 4, arrays, 5); // stable sort by i, j, k, l
+}
+
+/*
+ * Stable sort of the entries of arrays by keys (which may point into arrays).
+ * The permutation is applied to one array at a time through a single
+ * temporary array, or in place by CBF_permute if CBF_inplacesort is set.
+ */
+static CBFresponsee CBF_sortarrays(long long int nnz, const CBFsortkey *keys, int numkeys, const CBFsortarray *arrays, int numarrays) {
   CBFresponsee res = CBF_RES_OK;
-  long long int idx, *sortidx = NULL;
-  long long int *itmp = NULL;
-  double *vtmp = NULL;
+  long long int n, *sortidx = NULL;
+  size_t size = 0;
+  void *tmp = NULL;
+  int a;
 
-  if (nnz == 0) {
+  if (nnz == 0)
     return CBF_RES_OK;
-  } else {
-    sortidx = (long long int *) malloc(nnz * sizeof(sortidx[0]));
-    itmp = (long long int *) malloc(nnz * sizeof(i[0]));
-    vtmp = (double *) malloc(nnz * sizeof(v[0]));
-  }
 
-  if (sortidx && itmp && vtmp) {
-    for (idx = 0; idx < nnz; ++idx) {
-      sortidx[idx] = idx;
-      itmp[idx] = i[idx];
-      vtmp[idx] = v[idx];
-    }
+  sortidx = (long long int *) malloc(nnz * sizeof(sortidx[0]));
+  if (!sortidx)
+    return CBF_RES_ERR;
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxi, nnz, i, sortidx); // stable sort by i
+  for (n = 0; n < nnz; ++n)
+    sortidx[n] = n;
+
+  res = CBF_keysort(nnz, keys, numkeys, sortidx);
+
+  if (res == CBF_RES_OK) {
+    if (CBF_inplacesort) {
+      res = CBF_permute(nnz, sortidx, arrays, numarrays);
+
+    } else {
+      for (a = 0; a < numarrays; ++a)
+        if (arrays[a].size > size)
+          size = arrays[a].size;
 
-    if (res == CBF_RES_OK) {
-      for (idx = 0; idx < nnz; ++idx) {
-        i[idx] = itmp[sortidx[idx]];
-        v[idx] = vtmp[sortidx[idx]];
+      tmp = malloc(nnz * size);
+      if (!tmp)
+        res = CBF_RES_ERR;
+
+      for (a = 0; a < numarrays && res == CBF_RES_OK; ++a) {
+        memcpy(tmp, arrays[a].data, nnz * arrays[a].size);
+        res = CBF_gather(nnz, sortidx, arrays[a].data, tmp, arrays[a].size);
       }
-    }
 
-  } else {
-    res = CBF_RES_ERR;
+      free(tmp);
+    }
   }
 
-  if (sortidx)
-    free(sortidx);
-  if (itmp)
-    free(itmp);
-  if (vtmp)
-    free(vtmp);
-
+  free(sortidx);
   return res;
 }
 
-CBFresponsee CBF_coordinatesort(long long int *i, long long int *j, double *v, long long int nnz, long long int maxi, long long int maxj) {
+/*
+ * Stable sort of the sequence { (keys[0][idx[n]], keys[1][idx[n]], ...) }_n
+ * in lexicographic order. Keys are packed into as few 64-bit words as their
+ * maximal values allow, and the words are radix sorted in turn, the least
+ * significant first. Large inputs are packed and sorted by all threads.
+ */
+static CBFresponsee CBF_keysort(long long int nnz, const CBFsortkey *keys, int numkeys, long long int *idx) {
   CBFresponsee res = CBF_RES_OK;
-  long long int idx, *sortidx;
-  long long int *itmp = NULL;
-  long long int *jtmp = NULL;
-  double *vtmp = NULL;
+  CBFsortchunk *chunks = NULL;
+  unsigned long long int *key = NULL;
+  int first, last, keybits, c, numchunks;
 
-  if (nnz == 0) {
-    return CBF_RES_OK;
-  } else {
-    sortidx = (long long int *) malloc(nnz * sizeof(sortidx[0]));
-    itmp = (long long int *) malloc(nnz * sizeof(i[0]));
-    jtmp = (long long int *) malloc(nnz * sizeof(j[0]));
-    vtmp = (double *) malloc(nnz * sizeof(v[0]));
-  }
-
-  if (sortidx && itmp && jtmp && vtmp) {
-    for (idx = 0; idx < nnz; ++idx) {
-      sortidx[idx] = idx;
-      itmp[idx] = i[idx];
-      jtmp[idx] = j[idx];
-      vtmp[idx] = v[idx];
-    }
+  if (CBF_inplacesort)
+    return CBF_keysort_inplace(nnz, keys, numkeys, idx);
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxj, nnz, j, sortidx); // stable sort by j
+  key = (unsigned long long int *) malloc(nnz * sizeof(key[0]));
+  chunks = CBF_splitsort(nnz, &numchunks);
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxi, nnz, i, sortidx); // stable sort by i
+  if (!key || !chunks) {
+    free(key);
+    free(chunks);
+    return CBF_RES_ERR;
+  }
 
-    if (res == CBF_RES_OK) {
-      for (idx = 0; idx < nnz; ++idx) {
-        i[idx] = itmp[sortidx[idx]];
-        j[idx] = jtmp[sortidx[idx]];
-        v[idx] = vtmp[sortidx[idx]];
-      }
+  for (last = numkeys - 1; last >= 0 && res == CBF_RES_OK; last = first - 1) {
+
+    // Keys [first, last] fit in one word
+    keybits = CBF_bitlength(keys[last].maxval);
+    for (first = last; first >= 1 && keybits + CBF_bitlength(keys[first-1].maxval) <= 64; --first)
+      keybits += CBF_bitlength(keys[first-1].maxval);
+
+    for (c = 0; c < numchunks; ++c) {
+      chunks[c].keys = keys + first;
+      chunks[c].numkeys = last - first + 1;
+      chunks[c].key = key;
+      chunks[c].idx = idx;
     }
+    CBF_runtasks(numchunks, CBF_packkeys_task, chunks, sizeof(chunks[0]));
 
-  } else {
-    res = CBF_RES_ERR;
+    res = CBF_radixsort(nnz, keybits, key, idx, chunks, numchunks);
   }
 
-  if (sortidx)
-    free(sortidx);
-  if (itmp)
-    free(itmp);
-  if (jtmp)
-    free(jtmp);
-  if (vtmp)
-    free(vtmp);
-
+  free(key);
+  free(chunks);
   return res;
 }
 
-CBFresponsee CBF_coordinatesort(int *i, int *j, int *k, double *v, long long int nnz, long long int maxi, long long int maxj, long long int maxk) {
+/*
+ * CBF_keysort in place of the radix sort arrays. The pairs (key[n], idx[n])
+ * are sorted by CBF_flagsort, which keeps the sort stable while idx is
+ * ascending. Otherwise pairs of key and position are sorted, and idx is
+ * permuted in place. This needs 8 to 16 bytes per entry instead of 24.
+ */
+static CBFresponsee CBF_keysort_inplace(long long int nnz, const CBFsortkey *keys, int numkeys, long long int *idx) {
   CBFresponsee res = CBF_RES_OK;
-  long long int idx, *sortidx;
-  int *itmp = NULL;
-  int *jtmp = NULL;
-  int *ktmp = NULL;
-  double *vtmp = NULL;
+  CBFsortchunk chunk = { 0, };
+  CBFsortarray array = { idx, sizeof(idx[0]) };
+  unsigned long long int *key = NULL;
+  long long int n, *pos = NULL;
+  int first, last, keybits;
+
+  key = (unsigned long long int *) malloc(nnz * sizeof(key[0]));
+  if (!key)
+    return CBF_RES_ERR;
 
-  if (nnz == 0) {
-    return CBF_RES_OK;
-  } else {
-    sortidx = (long long int *) malloc(nnz * sizeof(sortidx[0]));
-    itmp = (int *) malloc(nnz * sizeof(i[0]));
-    jtmp = (int *) malloc(nnz * sizeof(j[0]));
-    ktmp = (int *) malloc(nnz * sizeof(k[0]));
-    vtmp = (double *) malloc(nnz * sizeof(v[0]));
-  }
-
-  if (sortidx && itmp && jtmp && ktmp && vtmp) {
-    for (idx = 0; idx < nnz; ++idx) {
-      sortidx[idx] = idx;
-      itmp[idx] = i[idx];
-      jtmp[idx] = j[idx];
-      ktmp[idx] = k[idx];
-      vtmp[idx] = v[idx];
+  for (last = numkeys - 1; last >= 0 && res == CBF_RES_OK; last = first - 1) {
+
+    // Keys [first, last] fit in one word
+    keybits = CBF_bitlength(keys[last].maxval);
+    for (first = last; first >= 1 && keybits + CBF_bitlength(keys[first-1].maxval) <= 64; --first)
+      keybits += CBF_bitlength(keys[first-1].maxval);
+
+    chunk.iend = nnz;
+    chunk.keys = keys + first;
+    chunk.numkeys = last - first + 1;
+    chunk.key = key;
+    chunk.idx = idx;
+    CBF_packkeys_task(&chunk);
+
+    for (n = 1; n < nnz && idx[n-1] < idx[n]; ++n);
+
+    if (n >= nnz) {
+      CBF_flagsort(nnz, keybits, key, CBF_bitlength(idx[nnz-1]), (unsigned long long int *) idx);
+
+    } else {
+      if (!pos)
+        pos = (long long int *) malloc(nnz * sizeof(pos[0]));
+
+      if (pos) {
+        for (n = 0; n < nnz; ++n)
+          pos[n] = n;
+
+        CBF_flagsort(nnz, keybits, key, CBF_bitlength(nnz - 1), (unsigned long long int *) pos);
+        res = CBF_permute(nnz, pos, &array, 1);
+      } else {
+        res = CBF_RES_ERR;
+      }
     }
+  }
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxk, nnz, k, sortidx); // stable sort by k
+  free(key);
+  free(pos);
+  return res;
+}
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxj, nnz, j, sortidx); // stable sort by j
+/*
+ * In-place MSD radix sort (American flag sort) of the pairs (key[n], val[n])
+ * by the lowest keybits bits of key, ties broken by the lowest valbits bits
+ * of val. The values of val are distinct, or val is NULL to sort key alone.
+ */
+static void CBF_flagsort(long long int nnz, int keybits, unsigned long long int *key, int valbits, unsigned long long int *val) {
+  long long int begin[1 << CBF_FLAG_BITS], next[1 << CBF_FLAG_BITS];
+  unsigned long long int k, v = 0, mask, swap;
+  long long int n, m, end;
+  int c, d, radix, shift;
+
+  if (nnz <= 1)
+    return;
+
+  // Equal keys are ordered by val
+  if (keybits == 0) {
+    if (val)
+      CBF_flagsort(nnz, valbits, val, 0, NULL);
+    return;
+  }
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxi, nnz, i, sortidx); // stable sort by i
-
-    if (res == CBF_RES_OK) {
-      for (idx = 0; idx < nnz; ++idx) {
-        i[idx] = itmp[sortidx[idx]];
-        j[idx] = jtmp[sortidx[idx]];
-        k[idx] = ktmp[sortidx[idx]];
-        v[idx] = vtmp[sortidx[idx]];
+  if (nnz <= CBF_FLAG_SMALL) {
+    for (n = 1; n < nnz; ++n) {
+      k = key[n];
+      if (val)
+        v = val[n];
+
+      for (m = n; m > 0 && (key[m-1] > k || (key[m-1] == k && val && val[m-1] > v)); --m) {
+        key[m] = key[m-1];
+        if (val)
+          val[m] = val[m-1];
       }
+
+      key[m] = k;
+      if (val)
+        val[m] = v;
     }
+    return;
+  }
 
-  } else {
-    res = CBF_RES_ERR;
+  shift = (keybits > CBF_FLAG_BITS) ? keybits - CBF_FLAG_BITS : 0;
+  radix = 1 << (keybits - shift);
+  mask = radix - 1;
+
+  memset(next, 0, radix * sizeof(next[0]));
+  for (n = 0; n < nnz; ++n)
+    ++next[(key[n] >> shift) & mask];
+
+  if (next[(key[0] >> shift) & mask] == nnz) {
+    CBF_flagsort(nnz, shift, key, valbits, val);
+    return;
   }
 
-  if (sortidx)
-    free(sortidx);
-  if (itmp)
-    free(itmp);
-  if (jtmp)
-    free(jtmp);
-  if (ktmp)
-    free(ktmp);
-  if (vtmp)
-    free(vtmp);
+  for (c = 0, n = 0; c < radix; ++c) {
+    begin[c] = n;
+    n += next[c];
+    next[c] = begin[c];
+  }
 
-  return res;
+  // Moves each misplaced pair to the next free slot of its digit, picking up the pair found there
+  for (c = 0; c < radix; ++c) {
+    end = (c + 1 < radix) ? begin[c+1] : nnz;
+
+    while (next[c] < end) {
+      k = key[next[c]];
+      if (val)
+        v = val[next[c]];
+
+      for (d = (int) ((k >> shift) & mask); d != c; d = (int) ((k >> shift) & mask)) {
+        swap = key[next[d]]; key[next[d]] = k; k = swap;
+        if (val) {
+          swap = val[next[d]]; val[next[d]] = v; v = swap;
+        }
+        ++next[d];
+      }
+
+      key[next[c]] = k;
+      if (val)
+        val[next[c]] = v;
+      ++next[c];
+    }
+  }
+
+  for (c = 0; c < radix; ++c)
+    CBF_flagsort(next[c] - begin[c], shift, key + begin[c], valbits, val ? val + begin[c] : NULL);
 }
 
-CBFresponsee CBF_coordinatesort(long long int *i, int *j, int *k, int *l, double *v, long long int nnz, long long int maxi, long long int maxj,
-    long long int maxk, long long int maxl) {
-  CBFresponsee res = CBF_RES_OK;
-  long long int idx, *sortidx;
-  long long int *itmp = NULL;
-  int *jtmp = NULL;
-  int *ktmp = NULL;
-  int *ltmp = NULL;
-  double *vtmp = NULL;
+/*
+ * Sets arrays[n] = arrays[perm[n]] for n in [0, nnz) in place, one cycle of
+ * the permutation at a time. Entries of perm are marked as done by flipping
+ * their bits, so perm is overwritten.
+ */
+static CBFresponsee CBF_permute(long long int nnz, long long int *perm, const CBFsortarray *arrays, int numarrays) {
+  long long int s, cur, next;
+  size_t size = 0;
+  char *saved, *data;
+  int a;
 
-  if (nnz == 0) {
+  for (a = 0; a < numarrays; ++a)
+    size += arrays[a].size;
+
+  saved = (char *) malloc(size);
+  if (!saved)
+    return CBF_RES_ERR;
+
+  for (s = 0; s < nnz; ++s) {
+    if (perm[s] < 0 || perm[s] == s)
+      continue;
+
+    for (a = 0, size = 0; a < numarrays; size += arrays[a].size, ++a)
+      memcpy(saved + size, (char *) arrays[a].data + s * arrays[a].size, arrays[a].size);
+
+    for (cur = s; (next = perm[cur]) != s; cur = next) {
+      for (a = 0; a < numarrays; ++a) {
+        data = (char *) arrays[a].data;
+        memcpy(data + cur * arrays[a].size, data + next * arrays[a].size, arrays[a].size);
+      }
+      perm[cur] = ~next;
+    }
+
+    for (a = 0, size = 0; a < numarrays; size += arrays[a].size, ++a)
+      memcpy((char *) arrays[a].data + cur * arrays[a].size, saved + size, arrays[a].size);
+    perm[cur] = ~s;
+  }
+
+  free(saved);
+  return CBF_RES_OK;
+}
+
+/*
+ * Stable LSD radix sort of idx by the lowest keybits bits of key, where
+ * key[n] belongs to idx[n] (key is overwritten). The histograms of all
+ * passes are counted in a single pass over key, and passes where all keys
+ * share the same digit are skipped.
+ */
+static CBFresponsee CBF_radixsort(long long int nnz, int keybits, unsigned long long int *key, long long int *idx, CBFsortchunk *chunks, int numchunks) {
+  const int radix = 1 << CBF_RADIX_BITS;
+  unsigned long long int *keytmp = NULL, *keyswap;
+  long long int *idxtmp = NULL, *idxswap, *idxout = idx;
+  long long int *count = NULL, *cnt, n, sum, c;
+  int numpasses, pass, shift;
+
+  if (numchunks >= 2)
+    return CBF_radixsort_parallel(nnz, keybits, key, idx, chunks, numchunks);
+
+  numpasses = (keybits + CBF_RADIX_BITS - 1) / CBF_RADIX_BITS;
+  if (nnz <= 1 || numpasses == 0)
     return CBF_RES_OK;
-  } else {
-    sortidx = (long long int *) malloc(nnz * sizeof(sortidx[0]));
-    itmp = (long long int *) malloc(nnz * sizeof(i[0]));
-    jtmp = (int *) malloc(nnz * sizeof(j[0]));
-    ktmp = (int *) malloc(nnz * sizeof(k[0]));
-    ltmp = (int *) malloc(nnz * sizeof(l[0]));
-    vtmp = (double *) malloc(nnz * sizeof(v[0]));
-  }
-
-  if (sortidx && itmp && jtmp && ktmp && ltmp && vtmp) {
-    for (idx = 0; idx < nnz; ++idx) {
-      sortidx[idx] = idx;
-      itmp[idx] = i[idx];
-      jtmp[idx] = j[idx];
-      ktmp[idx] = k[idx];
-      ltmp[idx] = l[idx];
-      vtmp[idx] = v[idx];
+
+  count = (long long int *) calloc(numpasses * (size_t) radix, sizeof(count[0]));
+  keytmp = (unsigned long long int *) malloc(nnz * sizeof(keytmp[0]));
+  idxtmp = (long long int *) malloc(nnz * sizeof(idxtmp[0]));
+
+  if (!count || !keytmp || !idxtmp) {
+    free(count);
+    free(keytmp);
+    free(idxtmp);
+    return CBF_RES_ERR;
+  }
+
+  for (n = 0; n < nnz; ++n)
+    for (pass = 0; pass < numpasses; ++pass)
+      ++count[pass * radix + ((key[n] >> (pass * CBF_RADIX_BITS)) & (radix - 1))];
+
+  for (pass = 0; pass < numpasses; ++pass) {
+    cnt = count + pass * radix;
+    shift = pass * CBF_RADIX_BITS;
+
+    if (cnt[(key[0] >> shift) & (radix - 1)] == nnz)
+      continue;
+
+    // Offsets of the digits in the output
+    for (c = 0, sum = 0; c < radix; ++c) {
+      n = cnt[c];
+      cnt[c] = sum;
+      sum += n;
     }
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxl, nnz, l, sortidx); // stable sort by l
+    for (n = 0; n < nnz; ++n) {
+      c = cnt[(key[n] >> shift) & (radix - 1)]++;
+      keytmp[c] = key[n];
+      idxtmp[c] = idx[n];
+    }
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxk, nnz, k, sortidx); // stable sort by k
+    keyswap = key; key = keytmp; keytmp = keyswap;
+    idxswap = idx; idx = idxtmp; idxtmp = idxswap;
+  }
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxj, nnz, j, sortidx); // stable sort by j
+  // After an odd number of moves the result is in the temporary arrays
+  if (idx != idxout) {
+    memcpy(idxout, idx, nnz * sizeof(idx[0]));
+    idxswap = idx; idx = idxtmp; idxtmp = idxswap;
+    keyswap = key; key = keytmp; keytmp = keyswap;
+  }
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxi, nnz, i, sortidx); // stable sort by i
-
-    if (res == CBF_RES_OK) {
-      for (idx = 0; idx < nnz; ++idx) {
-        i[idx] = itmp[sortidx[idx]];
-        j[idx] = jtmp[sortidx[idx]];
-        k[idx] = ktmp[sortidx[idx]];
-        l[idx] = ltmp[sortidx[idx]];
-        v[idx] = vtmp[sortidx[idx]];
+  free(count);
+  free(keytmp);
+  free(idxtmp);
+  return CBF_RES_OK;
+}
+
+/*
+ * CBF_radixsort with one thread per chunk. Every pass counts the digits of
+ * each chunk, and the entries of digit c from chunk t are moved behind those
+ * of smaller digits and of digit c from chunks before t, which keeps the
+ * sort stable.
+ */
+static CBFresponsee CBF_radixsort_parallel(long long int nnz, int keybits, unsigned long long int *key, long long int *idx, CBFsortchunk *chunks, int numchunks) {
+  const int radix = 1 << CBF_RADIX_BITS;
+  unsigned long long int *keytmp = NULL, *keyswap;
+  long long int *idxtmp = NULL, *idxswap, *idxout = idx;
+  long long int *count = NULL, n, sum;
+  int numpasses, pass, shift, c, t;
+
+  numpasses = (keybits + CBF_RADIX_BITS - 1) / CBF_RADIX_BITS;
+  if (numpasses == 0)
+    return CBF_RES_OK;
+
+  count = (long long int *) malloc(numchunks * (size_t) radix * sizeof(count[0]));
+  keytmp = (unsigned long long int *) malloc(nnz * sizeof(keytmp[0]));
+  idxtmp = (long long int *) malloc(nnz * sizeof(idxtmp[0]));
+
+  if (!count || !keytmp || !idxtmp) {
+    free(count);
+    free(keytmp);
+    free(idxtmp);
+    return CBF_RES_ERR;
+  }
+
+  for (pass = 0; pass < numpasses; ++pass) {
+    shift = pass * CBF_RADIX_BITS;
+
+    for (t = 0; t < numchunks; ++t) {
+      chunks[t].key = key;
+      chunks[t].keytmp = keytmp;
+      chunks[t].idx = idx;
+      chunks[t].idxtmp = idxtmp;
+      chunks[t].count = count + t * radix;
+      chunks[t].shift = shift;
+    }
+    CBF_runtasks(numchunks, CBF_countdigits_task, chunks, sizeof(chunks[0]));
+
+    c = (int) ((key[0] >> shift) & (radix - 1));
+    for (t = 0, sum = 0; t < numchunks; ++t)
+      sum += chunks[t].count[c];
+    if (sum == nnz)
+      continue;
+
+    // Offsets of the digits of each chunk in the output
+    for (c = 0, sum = 0; c < radix; ++c) {
+      for (t = 0; t < numchunks; ++t) {
+        n = chunks[t].count[c];
+        chunks[t].count[c] = sum;
+        sum += n;
       }
     }
+    CBF_runtasks(numchunks, CBF_scatterdigits_task, chunks, sizeof(chunks[0]));
 
-  } else {
-    res = CBF_RES_ERR;
+    keyswap = key; key = keytmp; keytmp = keyswap;
+    idxswap = idx; idx = idxtmp; idxtmp = idxswap;
   }
 
-  if (sortidx)
-    free(sortidx);
-  if (itmp)
-    free(itmp);
-  if (jtmp)
-    free(jtmp);
-  if (ktmp)
-    free(ktmp);
-  if (ltmp)
-    free(ltmp);
-  if (vtmp)
-    free(vtmp);
+  // After an odd number of moves the result is in the temporary arrays
+  if (idx != idxout) {
+    memcpy(idxout, idx, nnz * sizeof(idx[0]));
+    idxswap = idx; idx = idxtmp; idxtmp = idxswap;
+    keyswap = key; key = keytmp; keytmp = keyswap;
+  }
 
-  return res;
+  free(count);
+  free(keytmp);
+  free(idxtmp);
+  return CBF_RES_OK;
 }
 
-CBFresponsee CBF_coordinatesort(int *i, long long int *j, int *k, int *l, double *v, long long int nnz, long long int maxi, long long int maxj,
-    long long int maxk, long long int maxl) {
-  CBFresponsee res = CBF_RES_OK;
-  long long int idx, *sortidx;
-  int *itmp = NULL;
-  long long int *jtmp = NULL;
-  int *ktmp = NULL;
-  int *ltmp = NULL;
-  double *vtmp = NULL;
+// Sets dst[n] = src[idx[n]] for n in [0, nnz), for elements of the given size
+static CBFresponsee CBF_gather(long long int nnz, const long long int *idx, void *dst, const void *src, size_t size) {
+  CBFsortchunk *chunks;
+  int c, numchunks;
 
-  if (nnz == 0) {
-    return CBF_RES_OK;
-  } else {
-    sortidx = (long long int *) malloc(nnz * sizeof(sortidx[0]));
-    itmp = (int *) malloc(nnz * sizeof(i[0]));
-    jtmp = (long long int *) malloc(nnz * sizeof(j[0]));
-    ktmp = (int *) malloc(nnz * sizeof(k[0]));
-    ltmp = (int *) malloc(nnz * sizeof(l[0]));
-    vtmp = (double *) malloc(nnz * sizeof(v[0]));
-  }
-
-  if (sortidx && itmp && jtmp && ktmp && ltmp && vtmp) {
-    for (idx = 0; idx < nnz; ++idx) {
-      sortidx[idx] = idx;
-      itmp[idx] = i[idx];
-      jtmp[idx] = j[idx];
-      ktmp[idx] = k[idx];
-      ltmp[idx] = l[idx];
-      vtmp[idx] = v[idx];
-    }
+  chunks = CBF_splitsort(nnz, &numchunks);
+  if (!chunks)
+    return CBF_RES_ERR;
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxl, nnz, l, sortidx); // stable sort by l
+  for (c = 0; c < numchunks; ++c) {
+    chunks[c].idx = idx;
+    chunks[c].dst = dst;
+    chunks[c].src = src;
+    chunks[c].size = size;
+  }
+  CBF_runtasks(numchunks, CBF_gather_task, chunks, sizeof(chunks[0]));
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxk, nnz, k, sortidx); // stable sort by k
+  free(chunks);
+  return CBF_RES_OK;
+}
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxj, nnz, j, sortidx); // stable sort by j
+// Splits [0, nnz) into one chunk per thread of at least CBF_SORT_CHUNK entries
+static CBFsortchunk * CBF_splitsort(long long int nnz, int *numchunks) {
+  CBFsortchunk *chunks;
+  int c;
 
-    if (res == CBF_RES_OK)
-      res = CBF_bucketsort(maxi, nnz, i, sortidx); // stable sort by i
-
-    if (res == CBF_RES_OK) {
-      for (idx = 0; idx < nnz; ++idx) {
-        i[idx] = itmp[sortidx[idx]];
-        j[idx] = jtmp[sortidx[idx]];
-        k[idx] = ktmp[sortidx[idx]];
-        l[idx] = ltmp[sortidx[idx]];
-        v[idx] = vtmp[sortidx[idx]];
-      }
+  *numchunks = CBF_getthreads();
+  if (*numchunks > nnz / CBF_SORT_CHUNK)
+    *numchunks = (int) (nnz / CBF_SORT_CHUNK);
+  if (*numchunks < 1)
+    *numchunks = 1;
+
+  chunks = (CBFsortchunk *) calloc(*numchunks, sizeof(chunks[0]));
+  if (!chunks)
+    return NULL;
+
+  for (c = 0; c < *numchunks; ++c) {
+    chunks[c].ibeg = nnz * c / *numchunks;
+    chunks[c].iend = nnz * (c + 1) / *numchunks;
+  }
+
+  return chunks;
+}
+
+static void CBF_packkeys_task(void *chunk) {
+  CBFsortchunk *ch = (CBFsortchunk *) chunk;
+  const CBFsortkey *keys = ch->keys;
+  long long int n, val;
+  int k, bits, shift;
+
+  for (n = ch->ibeg; n < ch->iend; ++n)
+    ch->key[n] = 0;
+
+  for (k = ch->numkeys - 1, shift = 0; k >= 0; --k, shift += bits) {
+    bits = CBF_bitlength(keys[k].maxval);
+    if (bits == 0)
+      continue;
+
+    for (n = ch->ibeg; n < ch->iend; ++n) {
+      val = keys[k].lval ? keys[k].lval[ch->idx[n]] : keys[k].ival[ch->idx[n]];
+      ch->key[n] |= (unsigned long long int) val << shift;
     }
+  }
+}
+
+static void CBF_countdigits_task(void *chunk) {
+  CBFsortchunk *ch = (CBFsortchunk *) chunk;
+  const int radix = 1 << CBF_RADIX_BITS;
+  long long int n;
+
+  memset(ch->count, 0, radix * sizeof(ch->count[0]));
+  for (n = ch->ibeg; n < ch->iend; ++n)
+    ++ch->count[(ch->key[n] >> ch->shift) & (radix - 1)];
+}
 
+static void CBF_scatterdigits_task(void *chunk) {
+  CBFsortchunk *ch = (CBFsortchunk *) chunk;
+  const int radix = 1 << CBF_RADIX_BITS;
+  long long int n, c;
+
+  for (n = ch->ibeg; n < ch->iend; ++n) {
+    c = ch->count[(ch->key[n] >> ch->shift) & (radix - 1)]++;
+    ch->keytmp[c] = ch->key[n];
+    ch->idxtmp[c] = ch->idx[n];
+  }
+}
+
+static void CBF_gather_task(void *chunk) {
+  CBFsortchunk *ch = (CBFsortchunk *) chunk;
+  const char *src = (const char *) ch->src;
+  char *dst = (char *) ch->dst;
+  long long int n;
+
+  // Constant sizes let the copies compile to plain moves
+  if (ch->size == 4) {
+    for (n = ch->ibeg; n < ch->iend; ++n)
+      memcpy(dst + 4 * n, src + 4 * ch->idx[n], 4);
+  } else if (ch->size == 8) {
+    for (n = ch->ibeg; n < ch->iend; ++n)
+      memcpy(dst + 8 * n, src + 8 * ch->idx[n], 8);
   } else {
-    res = CBF_RES_ERR;
+    for (n = ch->ibeg; n < ch->iend; ++n)
+      memcpy(dst + ch->size * n, src + ch->size * ch->idx[n], ch->size);
   }
+}
 
-  if (sortidx)
-    free(sortidx);
-  if (itmp)
-    free(itmp);
-  if (jtmp)
-    free(jtmp);
-  if (ktmp)
-    free(ktmp);
-  if (ltmp)
-    free(ltmp);
-  if (vtmp)
-    free(vtmp);
+// Number of bits of the values in [0, maxval]
+static int CBF_bitlength(long long int maxval) {
+  int bits = 0;
 
-  return res;
+  while (bits < 63 && (maxval >> bits) != 0)
+    ++bits;
+
+  return bits;
 }
 
 CBFresponsee CBF_coordinatesort_rowmajor_map(CBFdata *data) {
@@ -456,16 +863,30 @@ CBFresponsee CBF_coordinatesort_rowmajor_map(CBFdata *data) {
     if (data->psdvardim[i] > maxpsdvardim)
       maxpsdvardim = data->psdvardim[i];
 
-  if (res == CBF_RES_OK)
+  // Blocks known to be sorted are left as they are
+  if (res == CBF_RES_OK && !(data->sorted & CBF_SORTED_F)) {
     res = CBF_coordinatesort(data->fsubi, data->fsubj, data->fsubk, data->fsubl, data->fval, data->fnnz, data->mapnum, data->psdvarnum, maxpsdvardim,
         maxpsdvardim);
 
-  if (res == CBF_RES_OK)
+    if (res == CBF_RES_OK)
+      data->sorted |= CBF_SORTED_F;
+  }
+
+  if (res == CBF_RES_OK && !(data->sorted & CBF_SORTED_A)) {
+    data->sorted &= ~CBF_SORTED_ACOL;
     res = CBF_coordinatesort(data->asubi, data->asubj, data->aval, data->annz, data->mapnum, data->varnum);
 
-  if (res == CBF_RES_OK)
+    if (res == CBF_RES_OK)
+      data->sorted |= CBF_SORTED_A;
+  }
+
+  if (res == CBF_RES_OK && !(data->sorted & CBF_SORTED_B)) {
     res = CBF_coordinatesort(data->bsubi, data->bval, data->bnnz, data->mapnum);
 
+    if (res == CBF_RES_OK)
+      data->sorted |= CBF_SORTED_B;
+  }
+
   return res;
 }
 
@@ -478,13 +899,22 @@ CBFresponsee CBF_coordinatesort_rowmajor_psdmap(CBFdata *data) {
     if (data->psdmapdim[i] > maxpsdmapdim)
       maxpsdmapdim = data->psdmapdim[i];
 
-  if (res == CBF_RES_OK)
+  // Blocks known to be sorted are left as they are
+  if (res == CBF_RES_OK && !(data->sorted & CBF_SORTED_H)) {
     res = CBF_coordinatesort(data->hsubi, data->hsubj, data->hsubk, data->hsubl, data->hval, data->hnnz, data->psdmapnum, data->varnum, maxpsdmapdim,
         maxpsdmapdim);
 
-  if (res == CBF_RES_OK)
+    if (res == CBF_RES_OK)
+      data->sorted |= CBF_SORTED_H;
+  }
+
+  if (res == CBF_RES_OK && !(data->sorted & CBF_SORTED_D)) {
     res = CBF_coordinatesort(data->dsubi, data->dsubk, data->dsubl, data->dval, data->dnnz, data->psdmapnum, maxpsdmapdim, maxpsdmapdim);
 
+    if (res == CBF_RES_OK)
+      data->sorted |= CBF_SORTED_D;
+  }
+
   return res;
 }
 
@@ -566,67 +996,158 @@ CBFresponsee CBF_findbackward_psdmap(const CBFdata *data, long long int psdmap,
 
 /*
  * ------------------------------------------------
- * Remove empty nnz and deleted maps
+ * Row and column index
  * ------------------------------------------------
  */
 
-CBFresponsee CBF_compress_maps(CBFdata *data, const char *delmap) {
+CBFresponsee CBF_buildindex_map(const CBFdata *data, CBFindex *index) {
+  CBFresponsee res = CBF_RES_OK;
+  long long int i, maxpsdvardim = 0;
+
+  for (i = 0; i < data->psdvarnum; ++i)
+    if (data->psdvardim[i] > maxpsdvardim)
+      maxpsdvardim = data->psdvardim[i];
+
+  if (res == CBF_RES_OK) {
+    CBFsortkey keys[] = { { data->fsubi, NULL, data->mapnum }, { NULL, data->fsubj, data->psdvarnum }, { NULL, data->fsubk, maxpsdvardim }, { NULL, data->fsubl, maxpsdvardim } };
+    res = CBF_buildrows(data->fnnz, keys, 4, data->sorted & CBF_SORTED_F, data->mapnum, &index->fptr, &index->fidx);
+  }
+
+  if (res == CBF_RES_OK) {
+    CBFsortkey keys[] = { { data->asubi, NULL, data->mapnum }, { data->asubj, NULL, data->varnum } };
+    res = CBF_buildrows(data->annz, keys, 2, data->sorted & CBF_SORTED_A, data->mapnum, &index->aptr, &index->aidx);
+  }
+
+  if (res == CBF_RES_OK) {
+    CBFsortkey keys[] = { { data->bsubi, NULL, data->mapnum } };
+    res = CBF_buildrows(data->bnnz, keys, 1, data->sorted & CBF_SORTED_B, data->mapnum, &index->bptr, &index->bidx);
+  }
+
+  return res;
+}
 
+CBFresponsee CBF_buildindex_psdmap(const CBFdata *data, CBFindex *index) {
   CBFresponsee res = CBF_RES_OK;
-  long long int k, r, rbeg, fbeg, abeg, bbeg;
-  long long int mapstacknum, mapstackdim, mapnum, fnnz, annz, bnnz;
+  long long int i, maxpsdmapdim = 0;
 
-  // Sort coordinates
-  res = CBF_coordinatesort_rowmajor_map(data);
+  for (i = 0; i < data->psdmapnum; ++i)
+    if (data->psdmapdim[i] > maxpsdmapdim)
+      maxpsdmapdim = data->psdmapdim[i];
 
-  // Rewrite coordinates
-  rbeg = bbeg = abeg = fbeg = 0;
-  mapstacknum = mapnum = fnnz = annz = bnnz = 0;
-  for (k = 0; k < data->mapstacknum && res == CBF_RES_OK; ++k) {
-    mapstackdim = 0;
+  if (res == CBF_RES_OK) {
+    CBFsortkey keys[] = { { NULL, data->hsubi, data->psdmapnum }, { data->hsubj, NULL, data->varnum }, { NULL, data->hsubk, maxpsdmapdim }, { NULL, data->hsubl, maxpsdmapdim } };
+    res = CBF_buildrows(data->hnnz, keys, 4, data->sorted & CBF_SORTED_H, data->psdmapnum, &index->hptr, &index->hidx);
+  }
 
-    for (r = rbeg; r < rbeg + data->mapstackdim[k] && res == CBF_RES_OK; ++r) {
-      if (!delmap || delmap[r] != 1) {
+  if (res == CBF_RES_OK) {
+    CBFsortkey keys[] = { { NULL, data->dsubi, data->psdmapnum }, { NULL, data->dsubk, maxpsdmapdim }, { NULL, data->dsubl, maxpsdmapdim } };
+    res = CBF_buildrows(data->dnnz, keys, 3, data->sorted & CBF_SORTED_D, data->psdmapnum, &index->dptr, &index->didx);
+  }
 
-        // FCOORD
-        while ((fbeg < data->fnnz) && (data->fsubi[fbeg] == r)) {
-          if (data->fval[fbeg] != 0.0) {
-            data->fsubi[fnnz] = mapnum;
-            data->fsubj[fnnz] = data->fsubj[fbeg];
-            data->fsubk[fnnz] = data->fsubk[fbeg];
-            data->fsubl[fnnz] = data->fsubl[fbeg];
-            data->fval[fnnz] = data->fval[fbeg];
-            ++fnnz;
-          }
-          ++fbeg;
-        }
+  return res;
+}
 
-        // ACOORD
-        while ((abeg < data->annz) && (data->asubi[abeg] == r)) {
-          if (data->aval[abeg] != 0.0) {
-            data->asubi[annz] = mapnum;
-            data->asubj[annz] = data->asubj[abeg];
-            data->aval[annz] = data->aval[abeg];
-            ++annz;
-          }
-          ++abeg;
-        }
+CBFresponsee CBF_buildindex_var(const CBFdata *data, CBFindex *index) {
+  CBFresponsee res = CBF_RES_OK;
 
-        // BCOORD
-        while ((bbeg < data->bnnz) && (data->bsubi[bbeg] == r)) {
-          if (data->bval[bbeg] != 0.0) {
-            data->bsubi[bnnz] = mapnum;
-            data->bval[bnnz] = data->bval[bbeg];
-            ++bnnz;
-          }
-          ++bbeg;
-        }
+  if (res == CBF_RES_OK) {
+    CBFsortkey keys[] = { { data->asubj, NULL, data->varnum }, { data->asubi, NULL, data->mapnum } };
+    res = CBF_buildrows(data->annz, keys, 2, data->sorted & CBF_SORTED_ACOL, data->varnum, &index->acolptr, &index->acolidx);
+  }
+
+  if (res == CBF_RES_OK) {
+    CBFsortkey keys[] = { { data->objasubj, NULL, data->varnum } };
+    res = CBF_buildrows(data->objannz, keys, 1, data->sorted & CBF_SORTED_OBJA, data->varnum, &index->objacolptr, &index->objacolidx);
+  }
+
+  return res;
+}
+
+void CBF_freeindex(CBFindex *index) {
+  long long int **arrays[] = { &index->fptr, &index->fidx, &index->aptr, &index->aidx, &index->bptr, &index->bidx,
+                               &index->hptr, &index->hidx, &index->dptr, &index->didx,
+                               &index->acolptr, &index->acolidx, &index->objacolptr, &index->objacolidx };
+  size_t a;
+
+  for (a = 0; a < sizeof(arrays) / sizeof(arrays[0]); ++a) {
+    free(*arrays[a]);
+    *arrays[a] = NULL;
+  }
+}
+
+/*
+ * Sorts the nnz's by keys into *idx (unless already sorted), and points *ptr at the first
+ * of each row of keys[0] (in [0, numrows)). Replaces earlier arrays of *ptr and *idx.
+ */
+static CBFresponsee CBF_buildrows(long long int nnz, const CBFsortkey *keys, int numkeys, int sorted, long long int numrows, long long int **ptr, long long int **idx) {
+  CBFresponsee res = CBF_RES_OK;
+  long long int n, r;
+
+  free(*ptr);
+  free(*idx);
+
+  *ptr = (long long int *) calloc(numrows + 1, sizeof((*ptr)[0]));
+  *idx = (long long int *) malloc((nnz >= 1 ? nnz : 1) * sizeof((*idx)[0]));
+
+  if (!*ptr || !*idx)
+    res = CBF_RES_ERR;
+
+  if (res == CBF_RES_OK && nnz >= 1) {
+    for (n = 0; n < nnz; ++n)
+      (*idx)[n] = n;
+
+    if (!sorted)
+      res = CBF_keysort(nnz, keys, numkeys, *idx);
+  }
+
+  if (res == CBF_RES_OK) {
+    for (n = 0; n < nnz; ++n) {
+      r = keys[0].lval ? keys[0].lval[n] : keys[0].ival[n];
+      ++(*ptr)[r + 1];
+    }
+
+    for (r = 0; r < numrows; ++r)
+      (*ptr)[r + 1] += (*ptr)[r];
+  }
 
+  if (res != CBF_RES_OK) {
+    free(*ptr);
+    free(*idx);
+    *ptr = NULL;
+    *idx = NULL;
+  }
+
+  return res;
+}
+
+/*
+ * ------------------------------------------------
+ * Remove empty nnz and deleted maps
+ * ------------------------------------------------
+ */
+
+CBFresponsee CBF_compress_maps(CBFdata *data, const char *delmap) {
+  long long int k, r, n, nnz, rbeg;
+  long long int mapstacknum, mapstackdim, mapnum;
+  long long int *newmap;
+
+  // New index of each map, or -1 if deleted
+  newmap = (long long int *) malloc((data->mapnum >= 1 ? data->mapnum : 1) * sizeof(newmap[0]));
+  if (!newmap)
+    return CBF_RES_ERR;
+
+  rbeg = 0;
+  mapstacknum = mapnum = 0;
+  for (k = 0; k < data->mapstacknum; ++k) {
+    mapstackdim = 0;
+
+    for (r = rbeg; r < rbeg + data->mapstackdim[k]; ++r) {
+      if (!delmap || delmap[r] != 1) {
+        newmap[r] = mapnum;
         ++mapnum;
         ++mapstackdim;
-
       } else {
-        res = CBF_findforward_map(data, r + 1, &fbeg, &abeg, &bbeg);
+        newmap[r] = -1;
       }
     }
 
@@ -639,66 +1160,99 @@ CBFresponsee CBF_compress_maps(CBFdata *data, const char *delmap) {
     rbeg = r;
   }
 
-  data->fnnz = fnnz;
-  data->annz = annz;
-  data->bnnz = bnnz;
+  // FCOORD
+  for (n = 0, nnz = 0; n < data->fnnz; ++n) {
+    if (newmap[data->fsubi[n]] >= 0 && data->fval[n] != 0.0) {
+      data->fsubi[nnz] = newmap[data->fsubi[n]];
+      data->fsubj[nnz] = data->fsubj[n];
+      data->fsubk[nnz] = data->fsubk[n];
+      data->fsubl[nnz] = data->fsubl[n];
+      data->fval[nnz] = data->fval[n];
+      ++nnz;
+    }
+  }
+  data->fnnz = nnz;
+
+  // ACOORD
+  for (n = 0, nnz = 0; n < data->annz; ++n) {
+    if (newmap[data->asubi[n]] >= 0 && data->aval[n] != 0.0) {
+      data->asubi[nnz] = newmap[data->asubi[n]];
+      data->asubj[nnz] = data->asubj[n];
+      data->aval[nnz] = data->aval[n];
+      ++nnz;
+    }
+  }
+  data->annz = nnz;
+
+  // BCOORD
+  for (n = 0, nnz = 0; n < data->bnnz; ++n) {
+    if (newmap[data->bsubi[n]] >= 0 && data->bval[n] != 0.0) {
+      data->bsubi[nnz] = newmap[data->bsubi[n]];
+      data->bval[nnz] = data->bval[n];
+      ++nnz;
+    }
+  }
+  data->bnnz = nnz;
+
   data->mapnum = mapnum;
   data->mapstacknum = mapstacknum;
 
-  return res;
+  free(newmap);
+
+  // Sort coordinates (nothing to do if they were sorted before)
+  return CBF_coordinatesort_rowmajor_map(data);
 }
 
 CBFresponsee CBF_compress_psdmaps(CBFdata *data, const char *delpsdmap) {
-  CBFresponsee res = CBF_RES_OK;
-  long long int r, row, hbeg, dbeg;
-  long long int hnnz = 0, dnnz = 0, psdmapnum = 0;
+  long long int r, n, nnz;
+  int *newpsdmap, psdmapnum = 0;
 
-  // Sort coordinates
-  res = CBF_coordinatesort_rowmajor_psdmap(data);
+  // New index of each psdmap, or -1 if deleted
+  newpsdmap = (int *) malloc((data->psdmapnum >= 1 ? data->psdmapnum : 1) * sizeof(newpsdmap[0]));
+  if (!newpsdmap)
+    return CBF_RES_ERR;
 
-  // Process coordinates
-  r = row = hbeg = dbeg = 0;
-  while (r < data->psdmapnum && res == CBF_RES_OK) {
-    if (delpsdmap[r] != 1) {
+  for (r = 0; r < data->psdmapnum; ++r) {
+    if (!delpsdmap || delpsdmap[r] != 1) {
+      data->psdmapdim[psdmapnum] = data->psdmapdim[r];
+      newpsdmap[r] = psdmapnum;
       ++psdmapnum;
+    } else {
+      newpsdmap[r] = -1;
+    }
+  }
 
-      // HCOORD
-      while ((hbeg < data->hnnz) && (data->hsubi[hbeg] == r)) {
-        if (data->hval[hbeg] != 0.0) {
-          data->hsubi[hnnz] = r - row;
-          data->hsubj[hnnz] = data->hsubj[hbeg];
-          data->hsubk[hnnz] = data->hsubk[hbeg];
-          data->hsubl[hnnz] = data->hsubl[hbeg];
-          data->hval[hnnz] = data->hval[hbeg];
-          ++hnnz;
-        }
-        ++hbeg;
-      }
-
-      // DCOORD
-      while ((dbeg < data->dnnz) && (data->dsubi[dbeg] == r)) {
-        if (data->dval[dbeg] != 0.0) {
-          data->dsubi[dnnz] = r - row;
-          data->dsubk[dnnz] = data->dsubk[dbeg];
-          data->dsubl[dnnz] = data->dsubl[dbeg];
-          data->dval[dnnz] = data->dval[dbeg];
-          ++dnnz;
-        }
-        ++dbeg;
-      }
+  // HCOORD
+  for (n = 0, nnz = 0; n < data->hnnz; ++n) {
+    if (newpsdmap[data->hsubi[n]] >= 0 && data->hval[n] != 0.0) {
+      data->hsubi[nnz] = newpsdmap[data->hsubi[n]];
+      data->hsubj[nnz] = data->hsubj[n];
+      data->hsubk[nnz] = data->hsubk[n];
+      data->hsubl[nnz] = data->hsubl[n];
+      data->hval[nnz] = data->hval[n];
+      ++nnz;
+    }
+  }
+  data->hnnz = nnz;
 
-    } else {
-      ++row;
-      res = CBF_findforward_psdmap(data, r + 1, &hbeg, &dbeg);
+  // DCOORD
+  for (n = 0, nnz = 0; n < data->dnnz; ++n) {
+    if (newpsdmap[data->dsubi[n]] >= 0 && data->dval[n] != 0.0) {
+      data->dsubi[nnz] = newpsdmap[data->dsubi[n]];
+      data->dsubk[nnz] = data->dsubk[n];
+      data->dsubl[nnz] = data->dsubl[n];
+      data->dval[nnz] = data->dval[n];
+      ++nnz;
     }
-    ++r;
   }
+  data->dnnz = nnz;
 
-  data->hnnz = hnnz;
-  data->dnnz = dnnz;
   data->psdmapnum = psdmapnum;
 
-  return res;
+  free(newpsdmap);
+
+  // Sort coordinates (nothing to do if they were sorted before)
+  return CBF_coordinatesort_rowmajor_psdmap(data);
 }
 
 /*
@@ -1066,6 +1620,7 @@ CBFresponsee CBFdyn_intvar_add(CBFdyndata *dyndata, long long int idx) {
     return CBF_RES_ERR;
 
   ++dyndata->data->intvarnum;
+  dyndata->data->sorted &= ~CBF_SORTED_INT;
   dyndata->data->intvar[dyndata->data->intvarnum - 1] = idx;
 
   return CBF_RES_OK;
@@ -1207,6 +1762,7 @@ CBFresponsee CBFdyn_obja_add(CBFdyndata *dyndata, long long int objasubj, double
     return CBF_RES_ERR;
 
   ++dyndata->data->objannz;
+  dyndata->data->sorted &= ~CBF_SORTED_OBJA;
   dyndata->data->objasubj[dyndata->data->objannz - 1] = objasubj;
   dyndata->data->objaval[dyndata->data->objannz - 1] = objaval;
 
@@ -1255,6 +1811,7 @@ CBFresponsee CBFdyn_f_add(CBFdyndata *dyndata, long long int fsubi, int fsubj, i
     return CBF_RES_ERR;
 
   ++dyndata->data->fnnz;
+  dyndata->data->sorted &= ~CBF_SORTED_F;
   dyndata->data->fsubi[dyndata->data->fnnz - 1] = fsubi;
   dyndata->data->fsubj[dyndata->data->fnnz - 1] = fsubj;
   dyndata->data->fsubk[dyndata->data->fnnz - 1] = fsubk;
@@ -1296,6 +1853,7 @@ CBFresponsee CBFdyn_a_add(CBFdyndata *dyndata, long long int asubi, long long in
     return CBF_RES_ERR;
 
   ++dyndata->data->annz;
+  dyndata->data->sorted &= ~(CBF_SORTED_A | CBF_SORTED_ACOL);
   dyndata->data->asubi[dyndata->data->annz - 1] = asubi;
   dyndata->data->asubj[dyndata->data->annz - 1] = asubj;
   dyndata->data->aval[dyndata->data->annz - 1] = aval;
@@ -1333,6 +1891,7 @@ CBFresponsee CBFdyn_b_add(CBFdyndata *dyndata, long long int bsubi, double bval)
     return CBF_RES_ERR;
 
   ++dyndata->data->bnnz;
+  dyndata->data->sorted &= ~CBF_SORTED_B;
   dyndata->data->bsubi[dyndata->data->bnnz - 1] = bsubi;
   dyndata->data->bval[dyndata->data->bnnz - 1] = bval;
 
@@ -1376,6 +1935,7 @@ CBFresponsee CBFdyn_h_add(CBFdyndata *dyndata, int hsubi, long long int hsubj, i
     return CBF_RES_ERR;
 
   ++dyndata->data->hnnz;
+  dyndata->data->sorted &= ~CBF_SORTED_H;
   dyndata->data->hsubi[dyndata->data->hnnz - 1] = hsubi;
   dyndata->data->hsubj[dyndata->data->hnnz - 1] = hsubj;
   dyndata->data->hsubk[dyndata->data->hnnz - 1] = hsubk;
@@ -1419,6 +1979,7 @@ CBFresponsee CBFdyn_d_add(CBFdyndata *dyndata, int dsubi, int dsubk, int dsubl,
     return CBF_RES_ERR;
 
   ++dyndata->data->dnnz;
+  dyndata->data->sorted &= ~CBF_SORTED_D;
   dyndata->data->dsubi[dyndata->data->dnnz - 1] = dsubi;
   dyndata->data->dsubk[dyndata->data->dnnz - 1] = dsubk;
   dyndata->data->dsubl[dyndata->data->dnnz - 1] = dsubl;
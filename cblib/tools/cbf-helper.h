@@ -25,7 +25,7 @@
 
 /*
  * CBF_bucketsort is a stable sort (low to high) of the sequence { val[idx[i]] }_i.
- * CBF_coordinatesort uses it to sort by 'i' (primarily), followed by 'j', 'k' and 'l'.
+ * CBF_coordinatesort sorts by 'i' (primarily), followed by 'j', 'k' and 'l'.
  */
 CBFresponsee
 CBF_bucketsort(long long int maxval, long long int nnz, const long long int *val, long long int *idx);
@@ -33,6 +33,23 @@ CBF_bucketsort(long long int maxval, long long int nnz, const long long int *val
 CBFresponsee
 CBF_bucketsort(long long int maxval, long long int nnz, const int *val, long long int *idx);
 
+/*
+ * CBF_indexsort is a stable sort (low to high) of the sequence { (pval[idx[i]], sval[idx[i]]) }_i,
+ * primarily by 'pval' in [0, maxpval] and secondarily by 'sval' in [0, maxsval] (if not NULL).
+ * Like CBF_coordinatesort, it runs on all threads of CBF_getthreads() for large nnz.
+ */
+CBFresponsee
+CBF_indexsort(long long int nnz, const long long int *pval, long long int maxpval, const long long int *sval, long long int maxsval,
+    long long int *idx);
+
+/*
+ * CBF_setinplacesort selects in-place sorting (0 by default) for CBF_coordinatesort and CBF_indexsort.
+ * Besides the data, this needs 16 to 24 bytes per coordinate instead of 32, but runs on one thread
+ * and is slower. Process-wide, so set it once at startup before any sorting.
+ */
+void
+CBF_setinplacesort(int inplace);
+
 CBFresponsee
 CBF_coordinatesort(long long int *i, double *v, long long int nnz, long long int maxi);
 
@@ -48,6 +65,10 @@ CBF_coordinatesort(long long int *i, int *j, int *k, int *l, double *v, long lon
 CBFresponsee
 CBF_coordinatesort(int *i, long long int *j, int *k, int *l, double *v, long long int nnz, long long int maxi, long long int maxj, long long int maxk, long long int maxl);
 
+/*
+ * Sorts FCOORD, ACOORD and BCOORD (or HCOORD and DCOORD) row-major,
+ * skipping the blocks already flagged in data->sorted.
+ */
 CBFresponsee
 CBF_coordinatesort_rowmajor_map(CBFdata *data);
 
@@ -72,6 +93,54 @@ CBFresponsee
 CBF_findbackward_psdmap(const CBFdata *data, long long int psdmap, long long int *hend, long long int *dend);
 
 
+/*
+ * Compressed row and column index (CSR/CSC) of the coordinates, giving direct access to the nnz's of
+ * any map, psdmap or variable without sorting the data or scanning it. The nnz's of map r in ACOORD
+ * are aidx[n] for n in [aptr[r], aptr[r+1]), and likewise for FCOORD and BCOORD by map, for HCOORD
+ * and DCOORD by psdmap, and for ACOORD (acolptr, acolidx) and OBJACOORD by variable. The nnz's of
+ * a map or psdmap are ordered by their remaining indices, those of a variable by map, and ties keep
+ * the order of the data.
+ *
+ * Start from CBFindex index = { 0, }, build the parts you need, and release them with CBF_freeindex.
+ * An index is invalidated by any change to the coordinates.
+ */
+typedef struct CBFindex_struct {
+
+  // Map rows of FCOORD, ACOORD and BCOORD (mapnum+1 pointers)
+  long long int *fptr;
+  long long int *fidx;
+  long long int *aptr;
+  long long int *aidx;
+  long long int *bptr;
+  long long int *bidx;
+
+  // Psdmap rows of HCOORD and DCOORD (psdmapnum+1 pointers)
+  long long int *hptr;
+  long long int *hidx;
+  long long int *dptr;
+  long long int *didx;
+
+  // Variable columns of ACOORD and OBJACOORD (varnum+1 pointers)
+  long long int *acolptr;
+  long long int *acolidx;
+  long long int *objacolptr;
+  long long int *objacolidx;
+
+} CBFindex;
+
+CBFresponsee
+CBF_buildindex_map(const CBFdata *data, CBFindex *index);
+
+CBFresponsee
+CBF_buildindex_psdmap(const CBFdata *data, CBFindex *index);
+
+CBFresponsee
+CBF_buildindex_var(const CBFdata *data, CBFindex *index);
+
+void
+CBF_freeindex(CBFindex *index);
+
+
 /*
  * Helps you allocate, initialize and free a 0-1 array
  * indicating whether a 'var' index belongs to 'intvar'.
@@ -84,7 +153,8 @@ CBFintegerarray_free(char **integertable);
 
 
 /*
- * Helps you delete maps/psdmaps and get rid of empty nnz
+ * Helps you delete maps/psdmaps and get rid of empty nnz.
+ * The coordinates are left sorted in row-major order.
  */
 CBFresponsee
 CBF_compress_maps(CBFdata *data, const char *delmap);
@@ -0,0 +1,560 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "cbf-lexer.h"
+#include "cbf-data.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CBF_LEXER_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * An implementation of the primitives the lexer is built upon. digits
+ * returns the position after the run of decimal digits starting at p (p
+ * itself if there is none) and sets *val to its value, or returns NULL if
+ * the run is longer than 16 digits.
+ */
+typedef struct CBFlexer_struct {
+
+  const char *isa;
+  const char * (*newline)(const char *p, const char *end);
+  const char * (*digits)(const char *p, const char *end, unsigned long long int *val);
+
+} CBFlexer;
+
+#ifdef CBF_LEXER_X86
+static void
+  selectlexer(void) __attribute__((constructor));
+#endif
+
+static const char *
+  newline_scalar(const char *p, const char *end);
+
+static const char *
+  digits_scalar(const char *p, const char *end, unsigned long long int *val);
+
+static const char *
+  lexinteger_scalar(const char *p, const char *end, long long int *val);
+
+static const char *
+  lexdouble_scalar(const char *p, const char *end, double *val);
+
+#ifdef CBF_LEXER_X86
+static const char *
+  newline_sse2(const char *p, const char *end);
+
+static const char *
+  newline_avx2(const char *p, const char *end);
+
+static const char *
+  digits_sse41(const char *p, const char *end, unsigned long long int *val);
+#endif
+
+
+// -------------------------------------
+// Global variable
+// -------------------------------------
+
+static const CBFlexer lexer_scalar = { "scalar", newline_scalar, digits_scalar };
+
+#ifdef CBF_LEXER_X86
+static const CBFlexer lexer_sse41 = { "sse4.1", newline_sse2, digits_sse41 };
+static const CBFlexer lexer_avx2  = { "avx2",   newline_avx2, digits_sse41 };
+
+// Moves the digits of a run of length n to the end of a vector (zeros in front)
+static unsigned char CBF_DIGITSHUFFLE[17][16];
+#endif
+
+static const CBFlexer *CBF_LEXER = &lexer_scalar;
+
+static const double CBF_POW10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+static const unsigned long long int CBF_POW10INT[] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+  10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL };
+
+
+// -------------------------------------
+// Function definitions
+// -------------------------------------
+
+const char * CBF_lexnewline(const char *p, const char *end)
+{
+  return CBF_LEXER->newline(p, end);
+}
+
+const char * CBF_lexinteger(const char *p, const char *end, long long int *val)
+{
+  unsigned long long int acc;
+  const char *q = p, *r;
+  int neg = 0;
+
+  if (q < end && (*q == '+' || *q == '-')) {
+    neg = (*q == '-');
+    ++q;
+  }
+
+  // Decimal numbers of at most 16 digits can not overflow
+  if (q < end && *q >= '1' && *q <= '9') {
+    r = CBF_LEXER->digits(q, end, &acc);
+    if (r) {
+      *val = neg ? -(long long int)acc : (long long int)acc;
+      return r;
+    }
+  }
+
+  return lexinteger_scalar(p, end, val);
+}
+
+/*
+ * Decimal numbers with a mantissa below 2^53 and a decimal exponent of at
+ * most 22 in magnitude are converted exactly by a single multiplication or
+ * division (Clinger's fast path). Here the mantissa is assembled from the
+ * digits on both sides of the decimal point, at most 19 in total, while
+ * lexdouble_scalar handles all other input.
+ */
+const char * CBF_lexdouble(const char *p, const char *end, double *val)
+{
+  unsigned long long int mant, frac = 0;
+  const char *q = p, *r, *s;
+  long long int exp10, e = 0;
+  int neg = 0, expneg = 0, nint, nfrac = 0;
+  double v;
+
+  if (q < end && (*q == '+' || *q == '-')) {
+    neg = (*q == '-');
+    ++q;
+  }
+
+  r = CBF_LEXER->digits(q, end, &mant);
+  if (!r)
+    return lexdouble_scalar(p, end, val);
+  nint = (int)(r - q);
+
+  if (r < end && *r == '.') {
+    s = CBF_LEXER->digits(r + 1, end, &frac);
+    if (!s)
+      return lexdouble_scalar(p, end, val);
+    nfrac = (int)(s - (r + 1));
+    r = s;
+  }
+
+  if (nint + nfrac == 0 || nint + nfrac > 19 || (r < end && (*r == 'x' || *r == 'X')))
+    return lexdouble_scalar(p, end, val);
+
+  mant = mant * CBF_POW10INT[nfrac] + frac;
+  exp10 = -nfrac;
+
+  // Exponent (only if followed by digits)
+  if (r < end && (*r == 'e' || *r == 'E')) {
+    s = r + 1;
+    if (s < end && (*s == '+' || *s == '-')) {
+      expneg = (*s == '-');
+      ++s;
+    }
+    if (s < end && *s >= '0' && *s <= '9') {
+      for (; s < end && *s >= '0' && *s <= '9'; ++s)
+        if (e < 100000)
+          e = 10*e + (*s - '0');
+      exp10 += (expneg ? -e : e);
+      r = s;
+    }
+  }
+
+  if (mant > (1ULL << 53) || (mant != 0 && (exp10 < -22 || 22 < exp10)))
+    return lexdouble_scalar(p, end, val);
+
+  v = (double) mant;
+  if (mant != 0) {
+    if (exp10 < 0)
+      v /= CBF_POW10[-exp10];
+    else
+      v *= CBF_POW10[exp10];
+  }
+
+  *val = (neg ? -v : v);
+  return r;
+}
+
+int CBF_vlexscan(const char *p, const char *end, const char *format, va_list args)
+{
+  const char *f = format;
+  const char *q;
+  long long int ival;
+  double dval;
+  int count = 0, width, lmod;
+  char *str;
+
+  while (*f) {
+    if (*f == ' ' || *f == '\t' || *f == '\n') {
+      while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f'))
+        ++p;
+      ++f;
+      continue;
+    }
+
+    if (*f != '%') {
+      if (p == end || *p != *f)
+        return count;
+      ++p;
+      ++f;
+      continue;
+    }
+
+    // Conversion specification
+    ++f;
+    for (width = 0; *f >= '0' && *f <= '9'; ++f)
+      width = 10*width + (*f - '0');
+    for (lmod = 0; *f == 'l'; ++f)
+      ++lmod;
+
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f'))
+      ++p;
+
+    if (p == end)
+      return (count == 0) ? EOF : count;
+
+    switch (*f++) {
+    case 'i':
+      q = CBF_lexinteger(p, end, &ival);
+      if (!q)
+        return count;
+      if (lmod >= 2)
+        *va_arg(args, long long int*) = ival;
+      else if (lmod == 1)
+        *va_arg(args, long int*) = (long int) ival;
+      else
+        *va_arg(args, int*) = (int) ival;
+      break;
+
+    case 'g':
+      q = CBF_lexdouble(p, end, &dval);
+      if (!q)
+        return count;
+      if (lmod >= 1)
+        *va_arg(args, double*) = dval;
+      else
+        *va_arg(args, float*) = (float) dval;
+      break;
+
+    case 's':
+      str = va_arg(args, char*);
+      for (q = p; q < end && (width == 0 || q - p < width); ++q) {
+        if (*q == ' ' || *q == '\t' || *q == '\r' || *q == '\v' || *q == '\f')
+          break;
+        *str++ = *q;
+      }
+      *str = '\0';
+      break;
+
+    default:
+      return count;
+    }
+
+    p = q;
+    ++count;
+  }
+
+  return count;
+}
+
+const char * CBF_lexerisa(void)
+{
+  return CBF_LEXER->isa;
+}
+
+#ifdef CBF_LEXER_X86
+// Runs before main, so the lexer never changes while it is in use
+static void selectlexer(void)
+{
+  int n, j;
+
+  for (n=0; n<=16; ++n)
+    for (j=0; j<16; ++j)
+      CBF_DIGITSHUFFLE[n][j] = (j >= 16 - n) ? (unsigned char)(j - (16 - n)) : 0x80;
+
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    CBF_LEXER = &lexer_avx2;
+  else if (__builtin_cpu_supports("sse4.1"))
+    CBF_LEXER = &lexer_sse41;
+}
+#endif
+
+static const char * newline_scalar(const char *p, const char *end)
+{
+  return (const char*) memchr(p, '\n', end - p);
+}
+
+static const char * digits_scalar(const char *p, const char *end, unsigned long long int *val)
+{
+  unsigned long long int acc = 0;
+  const char *q;
+
+  for (q = p; q < end && *q >= '0' && *q <= '9'; ++q) {
+    if (q - p == 16)
+      return NULL;
+    acc = 10*acc + (*q - '0');
+  }
+
+  *val = acc;
+  return q;
+}
+
+/*
+ * Same syntax as the %lli conversion of scanf, for any number of digits.
+ */
+static const char * lexinteger_scalar(const char *p, const char *end, long long int *val)
+{
+  unsigned long long int acc = 0, limit;
+  unsigned int base = 10, digit;
+  const char *first;
+  int neg = 0, overflow = 0;
+
+  if (p < end && (*p == '+' || *p == '-')) {
+    neg = (*p == '-');
+    ++p;
+  }
+
+  if (p < end && *p == '0') {
+    base = 8;
+    if (end - p >= 3 && (p[1] == 'x' || p[1] == 'X') &&
+        ((p[2] >= '0' && p[2] <= '9') || (p[2] >= 'a' && p[2] <= 'f') || (p[2] >= 'A' && p[2] <= 'F'))) {
+      base = 16;
+      p += 2;
+    }
+  }
+
+  limit = (neg ? (unsigned long long int)LLONG_MAX + 1 : (unsigned long long int)LLONG_MAX);
+
+  for (first = p; p < end; ++p) {
+    if (*p >= '0' && *p <= '9')
+      digit = *p - '0';
+    else if (*p >= 'a' && *p <= 'f')
+      digit = *p - 'a' + 10;
+    else if (*p >= 'A' && *p <= 'F')
+      digit = *p - 'A' + 10;
+    else
+      break;
+
+    if (digit >= base)
+      break;
+
+    if (acc > (limit - digit) / base)
+      overflow = 1;
+    else
+      acc = acc*base + digit;
+  }
+
+  if (p == first)
+    return NULL;
+
+  if (overflow)
+    acc = limit;
+
+  if (neg)
+    *val = (acc == (unsigned long long int)LLONG_MAX + 1) ? LLONG_MIN : -(long long int)acc;
+  else
+    *val = (long long int)acc;
+
+  return p;
+}
+
+/*
+ * Same syntax as the %lg conversion of scanf, following the approach of
+ * CBF_lexdouble for up to 19 significant digits (leading zeros are not
+ * significant). Everything else (long mantissas, extreme exponents,
+ * hexadecimal floats, inf and nan) is handed over to strtod.
+ */
+static const char * lexdouble_scalar(const char *p, const char *end, double *val)
+{
+  char buf[CBF_MAX_LINE];
+  char *bufend;
+  const char *start = p;
+  const char *q;
+  unsigned long long int mant = 0;
+  int neg = 0, expneg = 0, fast = 1, hasdigits = 0, sigdigits = 0;
+  long long int exp10 = 0, e = 0;
+  size_t len;
+  double v;
+
+  if (p < end && (*p == '+' || *p == '-')) {
+    neg = (*p == '-');
+    ++p;
+  }
+
+  // Integer part
+  for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+    hasdigits = 1;
+    if (mant == 0 && *p == '0')
+      continue;
+    if (sigdigits < 19) {
+      mant = 10*mant + (*p - '0');
+      ++sigdigits;
+    } else {
+      fast = 0;
+    }
+  }
+
+  // Fractional part
+  if (p < end && *p == '.') {
+    for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+      hasdigits = 1;
+      if (mant == 0 && *p == '0') {
+        --exp10;
+        continue;
+      }
+      if (sigdigits < 19) {
+        mant = 10*mant + (*p - '0');
+        ++sigdigits;
+        --exp10;
+      } else {
+        fast = 0;
+      }
+    }
+  }
+
+  if (!hasdigits || (p < end && (*p == 'x' || *p == 'X')))
+    fast = 0;
+
+  // Exponent (only if followed by digits)
+  if (fast && p < end && (*p == 'e' || *p == 'E')) {
+    q = p + 1;
+    if (q < end && (*q == '+' || *q == '-')) {
+      expneg = (*q == '-');
+      ++q;
+    }
+    if (q < end && *q >= '0' && *q <= '9') {
+      for (; q < end && *q >= '0' && *q <= '9'; ++q)
+        if (e < 100000)
+          e = 10*e + (*q - '0');
+      exp10 += (expneg ? -e : e);
+      p = q;
+    }
+  }
+
+  if (fast && mant <= (1ULL << 53) && (mant == 0 || (-22 <= exp10 && exp10 <= 22))) {
+    v = (double) mant;
+    if (mant != 0) {
+      if (exp10 < 0)
+        v /= CBF_POW10[-exp10];
+      else
+        v *= CBF_POW10[exp10];
+    }
+    *val = (neg ? -v : v);
+    return p;
+  }
+
+  // Slow path
+  len = end - start;
+  if (len > sizeof(buf) - 1)
+    len = sizeof(buf) - 1;
+  memcpy(buf, start, len);
+  buf[len] = '\0';
+
+  *val = strtod(buf, &bufend);
+  if (bufend == buf)
+    return NULL;
+
+  return start + (bufend - buf);
+}
+
+
+#ifdef CBF_LEXER_X86
+
+// -------------------------------------
+// SSE2, SSE4.1 and AVX2 implementations
+// -------------------------------------
+
+__attribute__((target("sse2")))
+static const char * newline_sse2(const char *p, const char *end)
+{
+  const __m128i nl = _mm_set1_epi8('\n');
+  int mask;
+
+  for (; end - p >= 16; p += 16) {
+    mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), nl));
+    if (mask)
+      return p + __builtin_ctz(mask);
+  }
+
+  return newline_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char * newline_avx2(const char *p, const char *end)
+{
+  const __m256i nl = _mm256_set1_epi8('\n');
+  unsigned int mask;
+
+  for (; end - p >= 32; p += 32) {
+    mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), nl));
+    if (mask)
+      return p + __builtin_ctz(mask);
+  }
+
+  return newline_sse2(p, end);
+}
+
+/*
+ * Classifies 16 characters at once, and converts the run of digits at the
+ * front in a few multiply-add steps: pairs of digits, then groups of 4 and
+ * of 8, where the run is first moved to the end of the vector so every
+ * digit gets its proper weight. Short input (typically small integers at
+ * the end of a line) is left to the scalar loop, as no byte beyond end may
+ * be read.
+ */
+__attribute__((target("sse4.1")))
+static const char * digits_sse41(const char *p, const char *end, unsigned long long int *val)
+{
+  __m128i d, v;
+  unsigned int mask;
+  int n;
+
+  if (end - p < 16)
+    return digits_scalar(p, end, val);
+
+  d = _mm_sub_epi8(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8('0'));
+  mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d));
+  n = __builtin_ctz(~mask);
+
+  // A run of 16 digits may continue beyond the vector
+  if (n == 16 && end - p > 16 && p[16] >= '0' && p[16] <= '9')
+    return NULL;
+
+  d = _mm_shuffle_epi8(d, _mm_loadu_si128((const __m128i*)CBF_DIGITSHUFFLE[n]));
+  v = _mm_maddubs_epi16(d, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+  v = _mm_madd_epi16(v, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+  v = _mm_packus_epi32(v, v);
+  v = _mm_madd_epi16(v, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+
+  *val = (unsigned long long int)(unsigned int)_mm_cvtsi128_si32(v) * 100000000ULL +
+         (unsigned int)_mm_extract_epi32(v, 1);
+  return p + n;
+}
+
+#endif
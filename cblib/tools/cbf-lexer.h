@@ -0,0 +1,65 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef CBF_CBF_LEXER_H
+#define CBF_CBF_LEXER_H
+
+#include "programmingstyle.h"
+#include <stddef.h>
+#include <stdarg.h>
+
+/*
+ * Locale-free tokenizing of CBF text in [p, end), where end is typically the
+ * end of a line. Runs of digits and line breaks are located with SSE4.1 or
+ * AVX2 instructions when the processor supports them, as detected at
+ * startup, and with portable scalar code otherwise. All implementations
+ * give identical results.
+ */
+
+// Position of the first '\n' in [p, end), or NULL if there is none
+const char *
+CBF_lexnewline(const char *p, const char *end);
+
+/*
+ * Same syntax as the %lli conversion of scanf: optional sign followed by
+ * a decimal, octal (leading 0) or hexadecimal (leading 0x) number.
+ * Returns the position after the number, or NULL if no digits were found.
+ */
+const char *
+CBF_lexinteger(const char *p, const char *end, long long int *val);
+
+/*
+ * Same syntax as the %lg conversion of scanf. Returns the position after
+ * the number, or NULL if no number was found.
+ */
+const char *
+CBF_lexdouble(const char *p, const char *end, double *val);
+
+/*
+ * Replacement of vsscanf for the conversions %i, %lli, %lg and %s with an
+ * optional width. Returns the number of assigned conversions, or EOF if the
+ * input ended before the first conversion.
+ */
+int
+CBF_vlexscan(const char *p, const char *end, const char *format, va_list args);
+
+// Instruction set in use: "avx2", "sse4.1" or "scalar"
+const char *
+CBF_lexerisa(void);
+
+#endif
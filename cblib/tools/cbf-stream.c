@@ -0,0 +1,1178 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "cbf-stream.h"
+#include "cbf-thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef ZLIB_SUPPORT
+#include <zlib.h>
+#endif
+
+#ifdef ZSTD_SUPPORT
+#include <zstd.h>
+#endif
+
+#ifdef LZMA_SUPPORT
+#include <lzma.h>
+#endif
+
+// Formatted output is collected in a buffer of this size before writing
+#define CBF_STREAM_BUFFER  (1 << 20)
+
+/*
+ * Two blocks are used in turn. The consumer holds at most one of them, and
+ * the producer only fills blocks that are not full. Data is stored after
+ * CBF_BLOCK_TAIL bytes of headroom, where the consumer carries over the
+ * tail of the previous block.
+ */
+struct CBFblockreader_struct {
+
+  CBFblocksource source;
+  void          *src;
+
+  char          *buf[2];
+  long long int  len[2];
+  int            full[2];
+  int            cur;
+  int            ended;
+
+  // Read-ahead
+  int             threaded;
+  int             stop;
+  pthread_t       thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+
+};
+
+/*
+ * A codec moves bytes between a stream and a file, where handle is the
+ * state of the codec.
+ */
+typedef struct CBFcodec_struct {
+
+  const char *compression;
+  CBFresponsee  (*open)(CBFstream *st, const char *file);
+  long long int (*read)(CBFstream *st, char *buf, size_t len);
+  CBFresponsee  (*write)(CBFstream *st, const char *buf, size_t len);
+  CBFresponsee  (*close)(CBFstream *st);
+
+} CBFcodec;
+
+struct CBFstream_struct {
+
+  const CBFcodec *codec;
+  void           *handle;
+  int             write;
+
+  // Formatted output not yet passed to the codec
+  char  *fmt;
+  size_t fmtlen;
+
+  // Uncompressed output passed to the codec
+  long long int offset;
+  long long int lines;
+
+};
+
+static void *
+  CBF_produceblocks(void *reader);
+
+static const CBFcodec *
+  CBF_findcodec(const char *file);
+
+static CBFresponsee
+  CBF_flushstream(CBFstream *st);
+
+static CBFresponsee
+  CBF_codecwrite(CBFstream *st, const char *buf, size_t len);
+
+static long long int
+  CBF_countlines(const char *buf, size_t len);
+
+static FILE *
+  CBF_fopen(const char *file, int write);
+
+static int
+  CBF_fclose(FILE *pFile);
+
+static CBFresponsee
+  plain_open(CBFstream *st, const char *file);
+
+static long long int
+  plain_read(CBFstream *st, char *buf, size_t len);
+
+static CBFresponsee
+  plain_write(CBFstream *st, const char *buf, size_t len);
+
+static CBFresponsee
+  plain_close(CBFstream *st);
+
+static CBFresponsee
+  buffer_write(CBFstream *st, const char *buf, size_t len);
+
+static CBFresponsee
+  buffer_close(CBFstream *st);
+
+#ifdef ZLIB_SUPPORT
+// Uncompressed bytes per gzip member written in parallel
+#define CBF_GZ_BLOCK  (1 << 20)
+
+typedef struct CBFgzblock_struct {
+  char          *in;
+  size_t         inlen;
+  char          *out;
+  size_t         outsize;
+  size_t         outlen;
+  int            ok;
+} CBFgzblock;
+
+/*
+ * With two or more worker threads, output is collected in one block per
+ * thread. Full rounds of blocks are compressed in parallel, each as a gzip
+ * member of its own, and written in order (as pigz does). Otherwise, and
+ * for reading, zlib does all the work.
+ */
+typedef struct CBFgz_struct {
+  gzFile         gz;
+  FILE          *pFile;
+  CBFgzblock    *blocks;
+  int            numblocks;
+  int            maxblocks;
+  long long int  members;
+} CBFgz;
+
+static CBFresponsee
+  gz_open(CBFstream *st, const char *file);
+
+static long long int
+  gz_read(CBFstream *st, char *buf, size_t len);
+
+static CBFresponsee
+  gz_write(CBFstream *st, const char *buf, size_t len);
+
+static CBFresponsee
+  gz_close(CBFstream *st);
+
+static CBFresponsee
+  gz_writeblocks(CBFgz *gzs);
+
+static void
+  gz_deflate_task(void *block);
+#endif
+
+#ifdef ZSTD_SUPPORT
+typedef struct CBFzstd_struct {
+  FILE          *pFile;
+  ZSTD_DStream  *dstream;
+  ZSTD_CStream  *cstream;
+  char          *buf;
+  size_t         bufsize;
+  ZSTD_inBuffer  input;
+  size_t         pending;
+} CBFzstd;
+
+static CBFresponsee
+  zstd_open(CBFstream *st, const char *file);
+
+static long long int
+  zstd_read(CBFstream *st, char *buf, size_t len);
+
+static CBFresponsee
+  zstd_write(CBFstream *st, const char *buf, size_t len);
+
+static CBFresponsee
+  zstd_close(CBFstream *st);
+#endif
+
+#ifdef LZMA_SUPPORT
+typedef struct CBFxz_struct {
+  FILE         *pFile;
+  lzma_stream   strm;
+  uint8_t      *buf;
+  size_t        bufsize;
+  int           eof;
+} CBFxz;
+
+static CBFresponsee
+  xz_open(CBFstream *st, const char *file);
+
+static long long int
+  xz_read(CBFstream *st, char *buf, size_t len);
+
+static CBFresponsee
+  xz_write(CBFstream *st, const char *buf, size_t len);
+
+static CBFresponsee
+  xz_close(CBFstream *st);
+#endif
+
+
+// -------------------------------------
+// Global variable
+// -------------------------------------
+
+static const CBFcodec codec_plain = { NULL, plain_open, plain_read, plain_write, plain_close };
+
+// Output to a CBFbuffer, only opened by CBF_openbufferstream
+static const CBFcodec codec_buffer = { NULL, NULL, NULL, buffer_write, buffer_close };
+
+// List of compressed codecs
+static const CBFcodec plugs_codec[] = {
+#ifdef ZLIB_SUPPORT
+  { "gz",  gz_open,   gz_read,   gz_write,   gz_close },
+#endif
+#ifdef ZSTD_SUPPORT
+  { "zst", zstd_open, zstd_read, zstd_write, zstd_close },
+#endif
+#ifdef LZMA_SUPPORT
+  { "xz",  xz_open,   xz_read,   xz_write,   xz_close },
+#endif
+  { NULL, NULL, NULL, NULL, NULL }
+};
+
+// Diagnostics of frontends and backends (NULL for stdout)
+static FILE *CBF_messages = NULL;
+
+
+// -------------------------------------
+// Function definitions
+// -------------------------------------
+
+CBFblockreader * CBF_openblockreader(CBFblocksource source, void *src, int readahead)
+{
+  CBFblockreader *br;
+  int k;
+
+  br = (CBFblockreader*) calloc(1, sizeof(*br));
+  if (!br)
+    return NULL;
+
+  br->source = source;
+  br->src = src;
+  br->cur = -1;
+
+  for (k=0; k<2; ++k) {
+    br->buf[k] = (char*) malloc(CBF_BLOCK_TAIL + CBF_BLOCK_SIZE);
+    if (!br->buf[k]) {
+      CBF_closeblockreader(br);
+      return NULL;
+    }
+  }
+
+  // Falls back to reading on demand if no thread can be started
+  if (readahead) {
+    if (pthread_mutex_init(&br->mutex, NULL) == 0) {
+      if (pthread_cond_init(&br->cond, NULL) == 0) {
+        if (pthread_create(&br->thread, NULL, CBF_produceblocks, br) == 0) {
+          br->threaded = 1;
+        } else {
+          pthread_cond_destroy(&br->cond);
+          pthread_mutex_destroy(&br->mutex);
+        }
+      } else {
+        pthread_mutex_destroy(&br->mutex);
+      }
+    }
+  }
+
+  return br;
+}
+
+void CBF_closeblockreader(CBFblockreader *br)
+{
+  if (br->threaded) {
+    pthread_mutex_lock(&br->mutex);
+    br->stop = 1;
+    pthread_cond_broadcast(&br->cond);
+    pthread_mutex_unlock(&br->mutex);
+
+    pthread_join(br->thread, NULL);
+    pthread_cond_destroy(&br->cond);
+    pthread_mutex_destroy(&br->mutex);
+  }
+
+  free(br->buf[0]);
+  free(br->buf[1]);
+  free(br);
+}
+
+CBFresponsee CBF_nextblock(CBFblockreader *br, const char *tail, size_t taillen, const char **begin, const char **end, int *eof)
+{
+  int k = (br->cur + 1) % 2;
+
+  if (taillen > CBF_BLOCK_TAIL)
+    return CBF_RES_ERR;
+
+  if (br->ended) {
+    *begin = tail;
+    *end = tail + taillen;
+    *eof = 1;
+    return CBF_RES_OK;
+  }
+
+  if (br->threaded) {
+    pthread_mutex_lock(&br->mutex);
+    while (!br->full[k])
+      pthread_cond_wait(&br->cond, &br->mutex);
+    pthread_mutex_unlock(&br->mutex);
+  } else {
+    br->len[k] = br->source(br->src, br->buf[k] + CBF_BLOCK_TAIL, CBF_BLOCK_SIZE);
+  }
+
+  if (br->len[k] < 0)
+    return CBF_RES_ERR;
+
+  memcpy(br->buf[k] + CBF_BLOCK_TAIL - taillen, tail, taillen);
+
+  // The tail has been copied, so the current block can be refilled
+  if (br->threaded && br->cur >= 0) {
+    pthread_mutex_lock(&br->mutex);
+    br->full[br->cur] = 0;
+    pthread_cond_broadcast(&br->cond);
+    pthread_mutex_unlock(&br->mutex);
+  }
+
+  br->cur = k;
+  br->ended = (br->len[k] == 0);
+
+  *begin = br->buf[k] + CBF_BLOCK_TAIL - taillen;
+  *end = br->buf[k] + CBF_BLOCK_TAIL + br->len[k];
+  *eof = br->ended;
+  return CBF_RES_OK;
+}
+
+static void * CBF_produceblocks(void *reader)
+{
+  CBFblockreader *br = (CBFblockreader*) reader;
+  long long int len;
+  int k = 0;
+
+  pthread_mutex_lock(&br->mutex);
+  for (;;) {
+    while (br->full[k] && !br->stop)
+      pthread_cond_wait(&br->cond, &br->mutex);
+
+    if (br->stop)
+      break;
+
+    pthread_mutex_unlock(&br->mutex);
+    len = br->source(br->src, br->buf[k] + CBF_BLOCK_TAIL, CBF_BLOCK_SIZE);
+    pthread_mutex_lock(&br->mutex);
+
+    br->len[k] = len;
+    br->full[k] = 1;
+    pthread_cond_broadcast(&br->cond);
+
+    // Nothing more to read after the end of input or a failure
+    if (len <= 0)
+      break;
+
+    k = (k + 1) % 2;
+  }
+  pthread_mutex_unlock(&br->mutex);
+
+  return NULL;
+}
+
+CBFstream * CBF_openstream(const char *file, const char *mode)
+{
+  CBFstream *st;
+
+  st = (CBFstream*) calloc(1, sizeof(*st));
+  if (!st)
+    return NULL;
+
+  st->write = (mode[0] == 'w');
+  st->codec = CBF_findcodec(file);
+
+#ifdef ZLIB_SUPPORT
+  // Reading through zlib passes uncompressed data through
+  if (!st->write && st->codec == &codec_plain)
+    st->codec = &plugs_codec[0];
+#endif
+
+  if (st->write) {
+    st->fmt = (char*) malloc(CBF_STREAM_BUFFER);
+    if (!st->fmt) {
+      free(st);
+      return NULL;
+    }
+  }
+
+  if (st->codec->open(st, file) != CBF_RES_OK) {
+    free(st->fmt);
+    free(st);
+    return NULL;
+  }
+
+  return st;
+}
+
+CBFstream * CBF_openbufferstream(CBFbuffer *buf)
+{
+  CBFstream *st;
+
+  st = (CBFstream*) calloc(1, sizeof(*st));
+  if (!st)
+    return NULL;
+
+  st->write = 1;
+  st->codec = &codec_buffer;
+  st->handle = buf;
+
+  st->fmt = (char*) malloc(CBF_STREAM_BUFFER);
+  if (!st->fmt) {
+    free(st);
+    return NULL;
+  }
+
+  return st;
+}
+
+CBFresponsee CBF_closestream(CBFstream *st)
+{
+  CBFresponsee res = CBF_RES_OK;
+
+  if (st->write)
+    res = CBF_flushstream(st);
+
+  if (st->codec->close(st) != CBF_RES_OK)
+    res = CBF_RES_ERR;
+
+  free(st->fmt);
+  free(st);
+  return res;
+}
+
+long long int CBF_streamread(CBFstream *st, char *buf, size_t len)
+{
+  return st->codec->read(st, buf, len);
+}
+
+CBFresponsee CBF_streamwrite(CBFstream *st, const char *buf, size_t len)
+{
+  CBFresponsee res = CBF_RES_OK;
+
+  if (st->fmtlen + len <= CBF_STREAM_BUFFER) {
+    memcpy(st->fmt + st->fmtlen, buf, len);
+    st->fmtlen += len;
+    return res;
+  }
+
+  res = CBF_flushstream(st);
+
+  if (res == CBF_RES_OK)
+    res = CBF_codecwrite(st, buf, len);
+
+  return res;
+}
+
+int CBF_streamprintf(CBFstream *st, const char *format, ...)
+{
+  va_list args;
+  char *str;
+  int len;
+
+  va_start(args, format);
+  len = vsnprintf(st->fmt + st->fmtlen, CBF_STREAM_BUFFER - st->fmtlen, format, args);
+  va_end(args);
+
+  if (len < 0)
+    return len;
+
+  if ((size_t)len < CBF_STREAM_BUFFER - st->fmtlen) {
+    st->fmtlen += len;
+    return len;
+  }
+
+  // Did not fit, so the buffer is flushed and the text formatted again
+  if (CBF_flushstream(st) != CBF_RES_OK)
+    return -1;
+
+  if (len < CBF_STREAM_BUFFER) {
+    va_start(args, format);
+    vsnprintf(st->fmt, CBF_STREAM_BUFFER, format, args);
+    va_end(args);
+    st->fmtlen = len;
+    return len;
+  }
+
+  str = (char*) malloc(len + 1);
+  if (!str)
+    return -1;
+
+  va_start(args, format);
+  vsnprintf(str, len + 1, format, args);
+  va_end(args);
+
+  if (CBF_codecwrite(st, str, len) != CBF_RES_OK)
+    len = -1;
+
+  free(str);
+  return len;
+}
+
+char * CBF_streamreserve(CBFstream *st, size_t len)
+{
+  if (len > CBF_STREAM_BUFFER)
+    return NULL;
+
+  if (st->fmtlen + len > CBF_STREAM_BUFFER)
+    if (CBF_flushstream(st) != CBF_RES_OK)
+      return NULL;
+
+  return st->fmt + st->fmtlen;
+}
+
+void CBF_streamcommit(CBFstream *st, const char *end)
+{
+  st->fmtlen = end - st->fmt;
+}
+
+const char * CBF_streamcompression(const char *file)
+{
+  return CBF_findcodec(file)->compression;
+}
+
+const char * CBF_streamcompressions(int i)
+{
+  return plugs_codec[i].compression;
+}
+
+static const CBFcodec * CBF_findcodec(const char *file)
+{
+  size_t len, extlen;
+  const char *ext;
+  int i;
+
+  len = strlen(file);
+  for (i=0; plugs_codec[i].compression; ++i) {
+    extlen = strlen(plugs_codec[i].compression);
+    ext = file + len - extlen;
+    if (len >= extlen + 1 && ext[-1] == '.' && strcmp(ext, plugs_codec[i].compression) == 0)
+      return &plugs_codec[i];
+  }
+
+  return &codec_plain;
+}
+
+int CBF_isstdstream(const char *file)
+{
+  const char *compression = CBF_streamcompression(file);
+
+  if (compression)
+    return (strlen(file) == strlen(compression) + 2 && file[0] == '-');
+
+  return (strcmp(file, "-") == 0);
+}
+
+void CBF_setmessagestream(FILE *log)
+{
+  CBF_messages = log;
+}
+
+FILE * CBF_messagestream(void)
+{
+  return CBF_messages ? CBF_messages : stdout;
+}
+
+void CBF_streamtell(const CBFstream *st, long long int *offset, long long int *lines)
+{
+  *offset = st->offset + st->fmtlen;
+  *lines = st->lines + CBF_countlines(st->fmt, st->fmtlen);
+}
+
+static CBFresponsee CBF_flushstream(CBFstream *st)
+{
+  CBFresponsee res = CBF_RES_OK;
+
+  if (st->fmtlen >= 1)
+    res = CBF_codecwrite(st, st->fmt, st->fmtlen);
+
+  st->fmtlen = 0;
+  return res;
+}
+
+static CBFresponsee CBF_codecwrite(CBFstream *st, const char *buf, size_t len)
+{
+  st->offset += len;
+  st->lines += CBF_countlines(buf, len);
+
+  return st->codec->write(st, buf, len);
+}
+
+static long long int CBF_countlines(const char *buf, size_t len)
+{
+  const char *end = buf + len;
+  long long int lines = 0;
+
+  while (buf < end && (buf = (const char*) memchr(buf, '\n', end - buf)) != NULL) {
+    ++lines;
+    ++buf;
+  }
+
+  return lines;
+}
+
+// As fopen in binary mode, except for names of standard input and output
+static FILE * CBF_fopen(const char *file, int write)
+{
+  if (CBF_isstdstream(file))
+    return write ? stdout : stdin;
+
+  return fopen(file, write ? "wb" : "rb");
+}
+
+// As fclose, except that standard input and output are only flushed
+static int CBF_fclose(FILE *pFile)
+{
+  if (pFile == stdin)
+    return 0;
+
+  if (pFile == stdout)
+    return fflush(pFile);
+
+  return fclose(pFile);
+}
+
+
+// -------------------------------------
+// Codec: plain
+// -------------------------------------
+
+static CBFresponsee plain_open(CBFstream *st, const char *file)
+{
+  st->handle = CBF_fopen(file, st->write);
+  if (!st->handle)
+    return CBF_RES_ERR;
+
+  // Data is read and written in whole blocks, which stdio would only copy once more.
+  // Standard streams keep their buffering, as they may already have been used.
+  if (!CBF_isstdstream(file))
+    setvbuf((FILE*)st->handle, NULL, _IONBF, 0);
+
+  if (!st->write)
+    posix_fadvise(fileno((FILE*)st->handle), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  return CBF_RES_OK;
+}
+
+static long long int plain_read(CBFstream *st, char *buf, size_t len)
+{
+  size_t n = fread(buf, 1, len, (FILE*)st->handle);
+
+  if (n == 0 && ferror((FILE*)st->handle))
+    return -1;
+
+  return n;
+}
+
+static CBFresponsee plain_write(CBFstream *st, const char *buf, size_t len)
+{
+  return (fwrite(buf, 1, len, (FILE*)st->handle) == len) ? CBF_RES_OK : CBF_RES_ERR;
+}
+
+static CBFresponsee plain_close(CBFstream *st)
+{
+  return (CBF_fclose((FILE*)st->handle) == 0) ? CBF_RES_OK : CBF_RES_ERR;
+}
+
+
+// -------------------------------------
+// Codec: buffer
+// -------------------------------------
+
+static CBFresponsee buffer_write(CBFstream *st, const char *buf, size_t len)
+{
+  CBFbuffer *b = (CBFbuffer*) st->handle;
+  size_t capacity;
+  char *data;
+
+  if (b->capacity - b->len < len) {
+    capacity = (b->capacity >= 1) ? b->capacity : CBF_STREAM_BUFFER;
+    while (capacity - b->len < len)
+      capacity *= 2;
+
+    data = (char*) realloc(b->data, capacity);
+    if (!data)
+      return CBF_RES_ERR;
+
+    b->data = data;
+    b->capacity = capacity;
+  }
+
+  memcpy(b->data + b->len, buf, len);
+  b->len += len;
+  return CBF_RES_OK;
+}
+
+static CBFresponsee buffer_close(CBFstream *st)
+{
+  return CBF_RES_OK;
+}
+
+
+// -------------------------------------
+// Codec: gzip
+// -------------------------------------
+
+#ifdef ZLIB_SUPPORT
+static CBFresponsee gz_open(CBFstream *st, const char *file)
+{
+  CBFgz *gzs = (CBFgz*) calloc(1, sizeof(*gzs));
+  int b, ok = 1;
+
+  if (!gzs)
+    return CBF_RES_ERR;
+
+  if (st->write && CBF_getthreads() >= 2) {
+    gzs->maxblocks = CBF_getthreads();
+    gzs->pFile = CBF_fopen(file, 1);
+    gzs->blocks = (CBFgzblock*) calloc(gzs->maxblocks, sizeof(gzs->blocks[0]));
+    ok = (gzs->pFile && gzs->blocks);
+
+    for (b=0; b<gzs->maxblocks && ok; ++b) {
+      gzs->blocks[b].in = (char*) malloc(CBF_GZ_BLOCK);
+      ok = (gzs->blocks[b].in != NULL);
+    }
+
+    if (!ok) {
+      // Nothing was written, so the file created above is removed again
+      if (gzs->pFile) {
+        CBF_fclose(gzs->pFile);
+        if (!CBF_isstdstream(file))
+          remove(file);
+      }
+      for (b=0; b<gzs->maxblocks && gzs->blocks; ++b)
+        free(gzs->blocks[b].in);
+      free(gzs->blocks);
+      free(gzs);
+      return CBF_RES_ERR;
+    }
+
+    if (!CBF_isstdstream(file))
+      setvbuf(gzs->pFile, NULL, _IONBF, 0);
+
+  } else {
+    // zlib closes the descriptor, which must not be that of standard input or output
+    if (CBF_isstdstream(file))
+      gzs->gz = gzdopen(dup(fileno(st->write ? stdout : stdin)), st->write ? "wb" : "rb");
+    else
+      gzs->gz = gzopen(file, st->write ? "wb" : "rb");
+    if (gzs->gz)
+      gzbuffer(gzs->gz, 1 << 17);
+    ok = (gzs->gz != NULL);
+  }
+
+  if (!ok) {
+    free(gzs);
+    return CBF_RES_ERR;
+  }
+
+  st->handle = gzs;
+  return CBF_RES_OK;
+}
+
+static long long int gz_read(CBFstream *st, char *buf, size_t len)
+{
+  if (len > INT_MAX)
+    len = INT_MAX;
+
+  return gzread(((CBFgz*)st->handle)->gz, buf, (unsigned) len);
+}
+
+static CBFresponsee gz_write(CBFstream *st, const char *buf, size_t len)
+{
+  CBFgz *gzs = (CBFgz*) st->handle;
+  CBFgzblock *block;
+  size_t n;
+
+  while (gzs->gz && len >= 1) {
+    n = (len > INT_MAX) ? INT_MAX : len;
+
+    if (gzwrite(gzs->gz, buf, (unsigned int) n) != (int) n)
+      return CBF_RES_ERR;
+
+    buf += n;
+    len -= n;
+  }
+
+  while (gzs->pFile && len >= 1) {
+    if (gzs->numblocks == 0 || gzs->blocks[gzs->numblocks-1].inlen == CBF_GZ_BLOCK) {
+      if (gzs->numblocks == gzs->maxblocks)
+        if (gz_writeblocks(gzs) != CBF_RES_OK)
+          return CBF_RES_ERR;
+
+      ++gzs->numblocks;
+    }
+
+    block = &gzs->blocks[gzs->numblocks-1];
+    n = (len < CBF_GZ_BLOCK - block->inlen) ? len : CBF_GZ_BLOCK - block->inlen;
+
+    memcpy(block->in + block->inlen, buf, n);
+    block->inlen += n;
+    buf += n;
+    len -= n;
+  }
+
+  return CBF_RES_OK;
+}
+
+static CBFresponsee gz_close(CBFstream *st)
+{
+  CBFresponsee res = CBF_RES_OK;
+  CBFgz *gzs = (CBFgz*) st->handle;
+  int b;
+
+  if (gzs->gz)
+    if (gzclose(gzs->gz) != Z_OK)
+      res = CBF_RES_ERR;
+
+  if (gzs->pFile) {
+    // Empty output still gets a member, as from zlib
+    if (gzs->members == 0 && gzs->numblocks == 0)
+      gzs->numblocks = 1;
+
+    if (gzs->numblocks >= 1 && gzs->blocks[0].in)
+      if (gz_writeblocks(gzs) != CBF_RES_OK)
+        res = CBF_RES_ERR;
+
+    if (CBF_fclose(gzs->pFile) != 0)
+      res = CBF_RES_ERR;
+  }
+
+  for (b=0; b<gzs->maxblocks && gzs->blocks; ++b) {
+    free(gzs->blocks[b].in);
+    free(gzs->blocks[b].out);
+  }
+
+  free(gzs->blocks);
+  free(gzs);
+  return res;
+}
+
+static CBFresponsee gz_writeblocks(CBFgz *gzs)
+{
+  CBFresponsee res = CBF_RES_OK;
+  int b;
+
+  CBF_runtasks(gzs->numblocks, gz_deflate_task, gzs->blocks, sizeof(gzs->blocks[0]));
+
+  for (b=0; b<gzs->numblocks; ++b) {
+    if (res == CBF_RES_OK)
+      if (!gzs->blocks[b].ok || fwrite(gzs->blocks[b].out, 1, gzs->blocks[b].outlen, gzs->pFile) != gzs->blocks[b].outlen)
+        res = CBF_RES_ERR;
+
+    gzs->blocks[b].inlen = 0;
+  }
+
+  gzs->members += gzs->numblocks;
+  gzs->numblocks = 0;
+  return res;
+}
+
+static void gz_deflate_task(void *block)
+{
+  CBFgzblock *b = (CBFgzblock*) block;
+  z_stream zs;
+  uLong bound;
+  char *out;
+
+  memset(&zs, 0, sizeof(zs));
+  b->ok = 0;
+
+  // Window bits above 15 select the gzip wrapper
+  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return;
+
+  bound = deflateBound(&zs, (uLong) b->inlen);
+  if (b->outsize < bound) {
+    out = (char*) realloc(b->out, bound);
+    if (!out) {
+      deflateEnd(&zs);
+      return;
+    }
+    b->out = out;
+    b->outsize = bound;
+  }
+
+  zs.next_in = (Bytef*) b->in;
+  zs.avail_in = (uInt) b->inlen;
+  zs.next_out = (Bytef*) b->out;
+  zs.avail_out = (uInt) b->outsize;
+
+  b->ok = (deflate(&zs, Z_FINISH) == Z_STREAM_END);
+  b->outlen = b->outsize - zs.avail_out;
+  deflateEnd(&zs);
+}
+#endif
+
+
+// -------------------------------------
+// Codec: zstd
+// -------------------------------------
+
+#ifdef ZSTD_SUPPORT
+static CBFresponsee zstd_open(CBFstream *st, const char *file)
+{
+  CBFzstd *zs = (CBFzstd*) calloc(1, sizeof(*zs));
+
+  if (!zs)
+    return CBF_RES_ERR;
+
+  zs->pFile = CBF_fopen(file, st->write);
+  if (st->write) {
+    zs->cstream = ZSTD_createCStream();
+    zs->bufsize = ZSTD_CStreamOutSize();
+
+    // Ignored by libraries built without multithreading
+    if (zs->cstream && CBF_getthreads() >= 2)
+      ZSTD_CCtx_setParameter(zs->cstream, ZSTD_c_nbWorkers, CBF_getthreads());
+  } else {
+    zs->dstream = ZSTD_createDStream();
+    zs->bufsize = ZSTD_DStreamInSize();
+  }
+  zs->buf = (char*) malloc(zs->bufsize);
+
+  if (!zs->pFile || !(zs->cstream || zs->dstream) || !zs->buf) {
+    if (zs->pFile)
+      CBF_fclose(zs->pFile);
+    ZSTD_freeCStream(zs->cstream);
+    ZSTD_freeDStream(zs->dstream);
+    free(zs->buf);
+    free(zs);
+    return CBF_RES_ERR;
+  }
+
+  st->handle = zs;
+  return CBF_RES_OK;
+}
+
+static long long int zstd_read(CBFstream *st, char *buf, size_t len)
+{
+  CBFzstd *zs = (CBFzstd*) st->handle;
+  ZSTD_outBuffer output = { buf, len, 0 };
+  size_t n;
+
+  while (output.pos < output.size) {
+    if (zs->input.pos == zs->input.size) {
+      n = fread(zs->buf, 1, zs->bufsize, zs->pFile);
+      if (n == 0) {
+        // Input ending inside a frame is truncated
+        if (ferror(zs->pFile) || (zs->pending != 0 && output.pos == 0))
+          return -1;
+        break;
+      }
+      zs->input.src = zs->buf;
+      zs->input.size = n;
+      zs->input.pos = 0;
+    }
+
+    // Failures are reported once the data before them has been returned
+    zs->pending = ZSTD_decompressStream(zs->dstream, &output, &zs->input);
+    if (ZSTD_isError(zs->pending))
+      return (output.pos >= 1) ? (long long int) output.pos : -1;
+  }
+
+  return output.pos;
+}
+
+static CBFresponsee zstd_write(CBFstream *st, const char *buf, size_t len)
+{
+  CBFzstd *zs = (CBFzstd*) st->handle;
+  ZSTD_inBuffer input = { buf, len, 0 };
+  ZSTD_outBuffer output;
+  size_t ret;
+
+  while (input.pos < input.size) {
+    output.dst = zs->buf;
+    output.size = zs->bufsize;
+    output.pos = 0;
+
+    ret = ZSTD_compressStream2(zs->cstream, &output, &input, ZSTD_e_continue);
+    if (ZSTD_isError(ret) || fwrite(zs->buf, 1, output.pos, zs->pFile) != output.pos)
+      return CBF_RES_ERR;
+  }
+
+  return CBF_RES_OK;
+}
+
+static CBFresponsee zstd_close(CBFstream *st)
+{
+  CBFresponsee res = CBF_RES_OK;
+  CBFzstd *zs = (CBFzstd*) st->handle;
+  ZSTD_inBuffer input = { NULL, 0, 0 };
+  ZSTD_outBuffer output;
+  size_t ret = 1;
+
+  while (st->write && ret != 0 && res == CBF_RES_OK) {
+    output.dst = zs->buf;
+    output.size = zs->bufsize;
+    output.pos = 0;
+
+    ret = ZSTD_compressStream2(zs->cstream, &output, &input, ZSTD_e_end);
+    if (ZSTD_isError(ret) || fwrite(zs->buf, 1, output.pos, zs->pFile) != output.pos)
+      res = CBF_RES_ERR;
+  }
+
+  if (CBF_fclose(zs->pFile) != 0)
+    res = CBF_RES_ERR;
+
+  ZSTD_freeCStream(zs->cstream);
+  ZSTD_freeDStream(zs->dstream);
+  free(zs->buf);
+  free(zs);
+  return res;
+}
+#endif
+
+
+// -------------------------------------
+// Codec: xz
+// -------------------------------------
+
+#ifdef LZMA_SUPPORT
+static CBFresponsee xz_open(CBFstream *st, const char *file)
+{
+  CBFxz *xz = (CBFxz*) calloc(1, sizeof(*xz));
+  lzma_stream init = LZMA_STREAM_INIT;
+  lzma_mt mt;
+  lzma_ret ret;
+
+  if (!xz)
+    return CBF_RES_ERR;
+
+  xz->strm = init;
+  if (st->write && CBF_getthreads() >= 2) {
+    memset(&mt, 0, sizeof(mt));
+    mt.threads = CBF_getthreads();
+    mt.preset = LZMA_PRESET_DEFAULT;
+    mt.check = LZMA_CHECK_CRC64;
+    ret = lzma_stream_encoder_mt(&xz->strm, &mt);
+  } else if (st->write)
+    ret = lzma_easy_encoder(&xz->strm, LZMA_PRESET_DEFAULT, LZMA_CHECK_CRC64);
+  else
+    ret = lzma_stream_decoder(&xz->strm, UINT64_MAX, LZMA_CONCATENATED);
+
+  xz->bufsize = 1 << 16;
+  xz->buf = (uint8_t*) malloc(xz->bufsize);
+  xz->pFile = CBF_fopen(file, st->write);
+
+  if (ret != LZMA_OK || !xz->buf || !xz->pFile) {
+    if (xz->pFile)
+      CBF_fclose(xz->pFile);
+    lzma_end(&xz->strm);
+    free(xz->buf);
+    free(xz);
+    return CBF_RES_ERR;
+  }
+
+  st->handle = xz;
+  return CBF_RES_OK;
+}
+
+static long long int xz_read(CBFstream *st, char *buf, size_t len)
+{
+  CBFxz *xz = (CBFxz*) st->handle;
+  lzma_ret ret;
+
+  xz->strm.next_out = (uint8_t*) buf;
+  xz->strm.avail_out = len;
+
+  while (xz->strm.avail_out >= 1) {
+    if (xz->strm.avail_in == 0 && !xz->eof) {
+      xz->strm.next_in = xz->buf;
+      xz->strm.avail_in = fread(xz->buf, 1, xz->bufsize, xz->pFile);
+      if (ferror(xz->pFile))
+        return -1;
+      xz->eof = feof(xz->pFile);
+    }
+
+    // Failures are reported once the data before them has been returned
+    ret = lzma_code(&xz->strm, xz->eof ? LZMA_FINISH : LZMA_RUN);
+    if (ret == LZMA_STREAM_END)
+      break;
+    if (ret != LZMA_OK)
+      return (xz->strm.avail_out < len) ? (long long int)(len - xz->strm.avail_out) : -1;
+  }
+
+  return len - xz->strm.avail_out;
+}
+
+static CBFresponsee xz_write(CBFstream *st, const char *buf, size_t len)
+{
+  CBFxz *xz = (CBFxz*) st->handle;
+  size_t n;
+
+  xz->strm.next_in = (const uint8_t*) buf;
+  xz->strm.avail_in = len;
+
+  while (xz->strm.avail_in >= 1) {
+    xz->strm.next_out = xz->buf;
+    xz->strm.avail_out = xz->bufsize;
+
+    if (lzma_code(&xz->strm, LZMA_RUN) != LZMA_OK)
+      return CBF_RES_ERR;
+
+    n = xz->bufsize - xz->strm.avail_out;
+    if (fwrite(xz->buf, 1, n, xz->pFile) != n)
+      return CBF_RES_ERR;
+  }
+
+  return CBF_RES_OK;
+}
+
+static CBFresponsee xz_close(CBFstream *st)
+{
+  CBFresponsee res = CBF_RES_OK;
+  CBFxz *xz = (CBFxz*) st->handle;
+  lzma_ret ret = LZMA_OK;
+  size_t n;
+
+  while (st->write && ret == LZMA_OK) {
+    xz->strm.next_out = xz->buf;
+    xz->strm.avail_out = xz->bufsize;
+
+    ret = lzma_code(&xz->strm, LZMA_FINISH);
+    if (ret != LZMA_OK && ret != LZMA_STREAM_END)
+      res = CBF_RES_ERR;
+
+    n = xz->bufsize - xz->strm.avail_out;
+    if (fwrite(xz->buf, 1, n, xz->pFile) != n)
+      res = CBF_RES_ERR;
+  }
+
+  if (CBF_fclose(xz->pFile) != 0)
+    res = CBF_RES_ERR;
+
+  lzma_end(&xz->strm);
+  free(xz->buf);
+  free(xz);
+  return res;
+}
+#endif
@@ -0,0 +1,141 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef CBF_CBF_STREAM_H
+#define CBF_CBF_STREAM_H
+
+#include "programmingstyle.h"
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Fills buf with up to len bytes of input and returns the number of bytes
+ * read, 0 at the end of input or -1 on failure. Short reads are allowed.
+ */
+typedef long long int (*CBFblocksource)(void *src, char *buf, size_t len);
+
+/*
+ * Reads input in large blocks, so text can be tokenized in place instead of
+ * being copied out line by line. With readahead, a thread of its own pulls
+ * the next block from the source (e.g. inflates it) while the caller is
+ * parsing the current one.
+ */
+typedef struct CBFblockreader_struct CBFblockreader;
+
+CBFblockreader *
+CBF_openblockreader(CBFblocksource source, void *src, int readahead);
+
+void
+CBF_closeblockreader(CBFblockreader *br);
+
+/*
+ * Moves to the next block and returns its data in [*begin, *end), preceded
+ * by a copy of [tail, tail+taillen), normally the incomplete line at the
+ * end of the current block. Sets *eof when the source is exhausted, in
+ * which case only the tail is returned. Fails on read errors and on tails
+ * longer than CBF_BLOCK_TAIL.
+ */
+CBFresponsee
+CBF_nextblock(CBFblockreader *br, const char *tail, size_t taillen, const char **begin, const char **end, int *eof);
+
+#define CBF_BLOCK_SIZE  (1 << 20)
+#define CBF_BLOCK_TAIL  (1 << 16)
+
+/*
+ * Byte streams to and from files, compressed according to the extension of
+ * the file name: .gz (ZLIB_SUPPORT), .zst (ZSTD_SUPPORT) and .xz
+ * (LZMA_SUPPORT). Other files are plain, except that with ZLIB_SUPPORT they
+ * are read through zlib, which recognizes gzip data irrespective of the
+ * name and passes anything else through unchanged. The file name "-", or
+ * "-" with the extension of a compression, denotes standard input when
+ * reading and standard output when writing.
+ */
+typedef struct CBFstream_struct CBFstream;
+
+// Mode is "r" or "w"
+CBFstream *
+CBF_openstream(const char *file, const char *mode);
+
+/*
+ * Growable memory buffer. Zero-initialize it before use and release data
+ * with free when done.
+ */
+typedef struct CBFbuffer_struct {
+
+  char   *data;
+  size_t  len;
+  size_t  capacity;
+
+} CBFbuffer;
+
+// Output stream appending to buf, which must outlive the stream
+CBFstream *
+CBF_openbufferstream(CBFbuffer *buf);
+
+// Fails if pending output could not be written
+CBFresponsee
+CBF_closestream(CBFstream *st);
+
+// As CBFblocksource
+long long int
+CBF_streamread(CBFstream *st, char *buf, size_t len);
+
+CBFresponsee
+CBF_streamwrite(CBFstream *st, const char *buf, size_t len);
+
+// As fprintf
+int
+CBF_streamprintf(CBFstream *st, const char *format, ...);
+
+/*
+ * Direct access to the output buffer, for text formatted without printf
+ * (see cbf-dtoa.h). CBF_streamreserve returns room for at least len bytes,
+ * flushing pending output if needed, or NULL on failure. What is written
+ * there becomes output when CBF_streamcommit is called with its end.
+ */
+char *
+CBF_streamreserve(CBFstream *st, size_t len);
+
+void
+CBF_streamcommit(CBFstream *st, const char *end);
+
+// Position in the uncompressed output: bytes and line breaks written so far
+void
+CBF_streamtell(const CBFstream *st, long long int *offset, long long int *lines);
+
+// Compression of a file name, e.g. "gz" (NULL if plain or not compiled in)
+const char *
+CBF_streamcompression(const char *file);
+
+// Supported compressions, e.g. "gz", for i = 0, 1, ... until NULL
+const char *
+CBF_streamcompressions(int i);
+
+// Whether a file name denotes standard input or output, e.g. "-" or "-.gz"
+int
+CBF_isstdstream(const char *file);
+
+// Stream for the diagnostics of frontends and backends (stdout by default).
+// Set it to stderr while standard output carries data.
+void
+CBF_setmessagestream(FILE *log);
+
+FILE *
+CBF_messagestream(void);
+
+#endif
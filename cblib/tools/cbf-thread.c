@@ -0,0 +1,103 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "cbf-thread.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct CBFtask_struct {
+  void (*task)(void *arg);
+  void *arg;
+} CBFtask;
+
+static void *
+  runtask(void *task);
+
+
+// -------------------------------------
+// Global variable
+// -------------------------------------
+
+static int CBF_THREADS = 0;
+
+
+// -------------------------------------
+// Function definitions
+// -------------------------------------
+
+void CBF_setthreads(int threads)
+{
+  CBF_THREADS = (threads >= 0) ? threads : 0;
+}
+
+int CBF_getthreads(void)
+{
+  long online;
+
+  if (CBF_THREADS >= 1)
+    return CBF_THREADS;
+
+  online = sysconf(_SC_NPROCESSORS_ONLN);
+  return (online >= 1) ? (int) online : 1;
+}
+
+void CBF_runtasks(int numtasks, void (*task)(void *arg), void *args, size_t argsize)
+{
+  pthread_t *threads = NULL;
+  CBFtask *tasks = NULL;
+  char *started = NULL;
+  int t;
+
+  if (numtasks >= 2) {
+    threads = (pthread_t*) malloc(numtasks * sizeof(threads[0]));
+    tasks = (CBFtask*) malloc(numtasks * sizeof(tasks[0]));
+    started = (char*) calloc(numtasks, sizeof(started[0]));
+  }
+
+  if (threads && tasks && started) {
+    for (t=1; t<numtasks; ++t) {
+      tasks[t].task = task;
+      tasks[t].arg = (char*)args + t*argsize;
+      started[t] = (pthread_create(&threads[t], NULL, runtask, &tasks[t]) == 0);
+    }
+  }
+
+  task(args);
+
+  for (t=1; t<numtasks; ++t) {
+    if (started && started[t])
+      pthread_join(threads[t], NULL);
+    else
+      task((char*)args + t*argsize);
+  }
+
+  if (threads)
+    free(threads);
+  if (tasks)
+    free(tasks);
+  if (started)
+    free(started);
+}
+
+static void * runtask(void *task)
+{
+  ((CBFtask*)task)->task(((CBFtask*)task)->arg);
+  return NULL;
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#ifndef CBF_CBF_THREAD_H
+#define CBF_CBF_THREAD_H
+
+#include "programmingstyle.h"
+#include <stddef.h>
+
+/*
+ * Process-wide number of worker threads used by the parallel parts of the
+ * tools. The default of 0 means one thread per online processor. Set it
+ * once at startup, before any parallel work is started.
+ */
+void
+CBF_setthreads(int threads);
+
+int
+CBF_getthreads(void);
+
+/*
+ * Runs task(args + t*argsize) for t = 0, ..., numtasks-1, each task on its
+ * own thread (task 0 on the calling thread), and returns when all are done.
+ * Tasks that could not get a thread of their own are run on the calling
+ * thread, so every task is always run exactly once.
+ */
+void
+CBF_runtasks(int numtasks, void (*task)(void *arg), void *args, size_t argsize);
+
+#endif
@@ -17,18 +17,31 @@
 // 3. This notice may not be removed or altered from any source distribution.
 
 #include "frontend-cbf.h"
+#include "frontend-cbfb.h"
 #include "backend-cbf.h"
+#include "backend-cbfb.h"
 #include "backend-mps-mosek.h"
 #include "backend-mps-cplex.h"
 #include "backend-sdpa.h"
 #include "transform-none.h"
 #include "transform-dual.h"
+#include "cbf-helper.h"
+#include "cbf-thread.h"
 
 #include "console.h"
 
 #include <string>
 #include <stdio.h>
 
+static CBFresponsee
+  rewritefile(const char *ifile, const char *ofile, bool index, bool trustinput, bool verbose);
+
+static CBFresponsee
+  rewriteblock(void *handle, const char *keyword, const CBFdata *data);
+
+static CBFresponsee
+  rewritecoordinates(void *handle, const char *keyword, const CBFdata *data, long long int first, long long int count);
+
 
 // -------------------------------------
 // Function definitions
@@ -44,6 +57,11 @@ int main (int argc, char *argv[])
   const char *ifile;
   const char *opath;
   const char *pfix;
+  const char *compress;
+  int threads;
+  bool trustinput;
+  bool stream;
+  bool inplacesort;
   bool verbose;
   int i;
 
@@ -52,9 +70,13 @@ int main (int argc, char *argv[])
 
   // List of plugins
   const CBFfrontend *plugs_frontend[] = {&frontend_cbf,
+                                         &frontend_cbf_mmap,
+                                         &frontend_cbfb,
                                          NULL};
 
   const CBFbackend  *plugs_backend[]  = {&backend_cbf,
+                                         &backend_cbf_index,
+                                         &backend_cbfb,
                                          &backend_mps_cplex,
                                          &backend_mps_mosek,
                                          &backend_sdpa,
@@ -70,6 +92,11 @@ int main (int argc, char *argv[])
   transform = default_transform = &transform_none;
   opath = NULL;
   pfix  = NULL;
+  compress = NULL;
+  threads = 0;
+  trustinput = false;
+  stream = false;
+  inplacesort = false;
   verbose = true;
 
   // User defined options
@@ -79,14 +106,22 @@ int main (int argc, char *argv[])
                    &transform,
                    &opath,
                    &pfix,
+                   &compress,
+                   &threads,
+                   &trustinput,
+                   &stream,
+                   &inplacesort,
                    &verbose);
 
+  CBF_setthreads(threads);
+  CBF_setinplacesort(inplacesort);
+
   if (argc <= 1 || res != CBF_RES_OK)
   {
     printf("\nBad command, syntax is:\n");
     printf(">> cbftool [OPTIONS] infile1 infile2 infile3 ...\n\n");
     printoptions(plugs_frontend, plugs_backend, plugs_transform,
-        default_frontend, default_backend, default_transform);
+        default_frontend, default_backend, default_transform, true, true);
   }
   else
   {
@@ -94,12 +129,67 @@ int main (int argc, char *argv[])
     for (i=1; i<argc && res==CBF_RES_OK; ++i) {
       if (argv[i]) {
         ifile = argv[i];
-        ofile = swapfiledirandext(ifile, opath, pfix, backend->format);
+        ofile = swapfiledirandext(ifile, opath, pfix, backend->format, compress);
 
-        res = processfile(frontend, backend, transform, ifile, ofile.c_str(), verbose);
+        // CBF to CBF without transformation can be streamed block by block in constant memory,
+        // on request as blocks then keep the order of the input file
+        if (stream && frontend == &frontend_cbf && transform == &transform_none && (backend == &backend_cbf || backend == &backend_cbf_index))
+          res = rewritefile(ifile, ofile.c_str(), backend == &backend_cbf_index, trustinput, verbose);
+        else
+          res = processfile(frontend, backend, transform, ifile, ofile.c_str(), trustinput, verbose);
       }
     }
   }
 
   return res;
 }
+
+static CBFresponsee rewritefile(const char *ifile, const char *ofile, bool index, bool trustinput, bool verbose)
+{
+  CBFresponsee res = CBF_RES_OK;
+  CBFcallbacks callbacks = { 0, };
+  CBFwriter *w;
+
+  // Messages must not mix with output to standard output
+  FILE *log = CBF_isstdstream(ofile) ? stderr : stdout;
+  CBF_setmessagestream(log);
+
+  if (verbose) {
+    fprintf(log, "Rewriting %s to %s\n", ifile, ofile);
+  }
+
+  w = CBF_openwriter(ofile, index);
+  if (!w) {
+    fprintf(log, "Failed to write file: %s\n", ofile);
+    return CBF_RES_ERR;
+  }
+
+  // Batches start at entries indexed by backend_cbf_index
+  callbacks.handle = w;
+  callbacks.batchsize = 65536;
+  callbacks.block = rewriteblock;
+  callbacks.coordinates = rewritecoordinates;
+  callbacks.trustinput = trustinput;
+
+  res = CBF_readstream(ifile, &callbacks);
+
+  if (res != CBF_RES_OK)
+    fprintf(log, "Failed to rewrite file: %s\n", ifile);
+
+  if (CBF_closewriter(w, res == CBF_RES_OK) != CBF_RES_OK && res == CBF_RES_OK) {
+    fprintf(log, "Failed to write file: %s\n", ofile);
+    res = CBF_RES_ERR;
+  }
+
+  return res;
+}
+
+static CBFresponsee rewriteblock(void *handle, const char *keyword, const CBFdata *data)
+{
+  return CBF_writeblock((CBFwriter*) handle, keyword, data);
+}
+
+static CBFresponsee rewritecoordinates(void *handle, const char *keyword, const CBFdata *data, long long int first, long long int count)
+{
+  return CBF_writecoordinates((CBFwriter*) handle, keyword, data, first, count);
+}
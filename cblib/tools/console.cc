@@ -17,6 +17,7 @@
 // 3. This notice may not be removed or altered from any source distribution.
 
 #include "console.h"
+#include "cbf-stream.h"
 
 #include <string>
 #include <string.h>
@@ -28,13 +29,13 @@
 // -------------------------------------
 
 void printoptions(const CBFfrontend **plugs_frontend, const CBFbackend **plugs_backend, const CBFtransform **plugs_transform,
-    const CBFfrontend *default_frontend, const CBFbackend *default_backend, const CBFtransform *default_transform) {
+    const CBFfrontend *default_frontend, const CBFbackend *default_backend, const CBFtransform *default_transform, bool inputchecks, bool streaming) {
   int i;
   printf("OPTIONS:\n");
 
   if (plugs_frontend[0] != NULL) {
-    printf("  -i format   : File manager for input files:\n");
-    printf("                ");
+    printf("  -i format     : File manager for input files:\n");
+    printf("                  ");
     for (i = 0; plugs_frontend[i] != NULL; ++i) {
       if (plugs_frontend[i] == default_frontend)
         printf("(%s), ", plugs_frontend[i]->name);
@@ -45,8 +46,8 @@ void printoptions(const CBFfrontend **plugs_frontend, const CBFbackend **plugs_b
   }
 
   if (plugs_backend[0] != NULL) {
-    printf("  -o format   : File manager for output files:\n");
-    printf("                ");
+    printf("  -o format     : File manager for output files:\n");
+    printf("                  ");
     for (i = 0; plugs_backend[i] != NULL; ++i) {
       if (plugs_backend[i] == default_backend)
         printf("(%s), ", plugs_backend[i]->name);
@@ -57,8 +58,8 @@ void printoptions(const CBFfrontend **plugs_frontend, const CBFbackend **plugs_b
   }
 
   if (plugs_transform[0] != NULL) {
-    printf("  -t method   : Problem transformation manager:\n");
-    printf("                ");
+    printf("  -t method     : Problem transformation manager:\n");
+    printf("                  ");
     for (i = 0; plugs_transform[i] != NULL; ++i) {
       if (plugs_transform[i] == default_transform)
         printf("(%s), ", plugs_transform[i]->name);
@@ -68,15 +69,35 @@ void printoptions(const CBFfrontend **plugs_frontend, const CBFbackend **plugs_b
     printf("\n");
   }
 
-  printf("  -opath path : Output destination.\n");
-  printf("  -pfix name  : Postfix for output files.\n");
-  printf("  -v          : Verbose.\n");
+  printf("  -opath path   : Output destination (- for standard output).\n");
+  printf("  -pfix name    : Postfix for output files.\n");
+
+  if (CBF_streamcompressions(0) != NULL) {
+    printf("  -z method     : Compression of output files:\n");
+    printf("                  ");
+    for (i = 0; CBF_streamcompressions(i) != NULL; ++i) {
+      printf("%s, ", CBF_streamcompressions(i));
+    }
+    printf("\n");
+  }
+
+  printf("  -threads n    : Number of worker threads (0 means one per processor).\n");
+  if (inputchecks)
+    printf("  -trust-input  : Skip range checks of indices in input files.\n");
+  printf("  -inplace-sort : Sort coordinates in place, slower but with less memory.\n");
+  if (streaming) {
+    printf("  -stream       : Rewrite CBF to CBF block by block in constant memory,\n");
+    printf("                  keeping the block order of the input file.\n");
+  }
+  printf("  -v            : Verbose.\n");
+
+  printf("\nAn infile named - is read from standard input and written to standard output.\n");
 
   printf("\n\n");
 }
 
 CBFresponsee getoptions(int argc, char *argv[], const CBFfrontend **plugs_frontend, const CBFbackend **plugs_backend, const CBFtransform **plugs_transform,
-    const CBFfrontend **frontend, const CBFbackend **backend, const CBFtransform **transform, const char **opath, const char **pfix, bool *verbose) {
+    const CBFfrontend **frontend, const CBFbackend **backend, const CBFtransform **transform, const char **opath, const char **pfix, const char **compress, int *threads, bool *trustinput, bool *stream, bool *inplacesort, bool *verbose) {
   CBFresponsee res = CBF_RES_OK;
   char const *frontend_name = "";
   char const *backend_name = "";
@@ -139,6 +160,40 @@ CBFresponsee getoptions(int argc, char *argv[], const CBFfrontend **plugs_fronte
         }
       }
 
+      else if (strcmp(argv[i], "-z") == 0) {
+        if (i + 1 < argc) {
+          *compress = argv[i + 1];
+          argv[i] = NULL;
+          argv[i + 1] = NULL;
+        } else {
+          res = CBF_RES_ERR;
+        }
+      }
+
+      else if (strcmp(argv[i], "-threads") == 0) {
+        if (i + 1 < argc && sscanf(argv[i + 1], "%i", threads) == 1 && *threads >= 0) {
+          argv[i] = NULL;
+          argv[i + 1] = NULL;
+        } else {
+          res = CBF_RES_ERR;
+        }
+      }
+
+      else if (strcmp(argv[i], "-trust-input") == 0 && trustinput) {
+        *trustinput = true;
+        argv[i] = NULL;
+      }
+
+      else if (strcmp(argv[i], "-stream") == 0 && stream) {
+        *stream = true;
+        argv[i] = NULL;
+      }
+
+      else if (strcmp(argv[i], "-inplace-sort") == 0) {
+        *inplacesort = true;
+        argv[i] = NULL;
+      }
+
       else if (strcmp(argv[i], "-v") == 0) {
         *verbose = true;
         argv[i] = NULL;
@@ -173,16 +228,37 @@ CBFresponsee getoptions(int argc, char *argv[], const CBFfrontend **plugs_fronte
 
     if (*frontend == NULL || *backend == NULL || *transform == NULL)
       res = CBF_RES_ERR;
+
+    // Identify compression by name
+    if (*compress) {
+      for (i = 0; CBF_streamcompressions(i) != NULL; ++i) {
+        if (strcmp(*compress, CBF_streamcompressions(i)) == 0)
+          break;
+      }
+
+      if (CBF_streamcompressions(i) == NULL)
+        res = CBF_RES_ERR;
+    }
   }
 
   return res;
 }
 
-const std::string swapfiledirandext(const char *ifile, const char *newpath, const char *newpostfix, const char *newformat) {
+const std::string swapfiledirandext(const char *ifile, const char *newpath, const char *newpostfix, const char *newformat, const char *newcompression) {
   std::string ifilestr = ifile;
   std::string ofilestr;
   int from, len;
 
+  // standard output
+  if (CBF_isstdstream(ifile) || (newpath && strcmp(newpath, "-") == 0)) {
+    ofilestr = "-";
+    if (newcompression && newcompression[0] != '\0') {
+      ofilestr += ".";
+      ofilestr += newcompression;
+    }
+    return ofilestr;
+  }
+
   // path
   if (newpath && newpath[0] != '\0') {
     ofilestr = newpath;
@@ -192,8 +268,8 @@ const std::string swapfiledirandext(const char *ifile, const char *newpath, cons
   }
 
   // name
-  if (ifilestr.length() >= 3 && ifilestr.substr(ifilestr.length() - 3, 3) == ".gz")
-    ifilestr[ifilestr.length() - 3] = '\0';
+  if (CBF_streamcompression(ifile))
+    ifilestr.resize(ifilestr.length() - strlen(CBF_streamcompression(ifile)) - 1);
 
   from = ifilestr.find_last_of("/\\") + 1;
   len = ifilestr.find_last_of(".") - from;
@@ -211,23 +287,33 @@ const std::string swapfiledirandext(const char *ifile, const char *newpath, cons
   ofilestr += ".";
   ofilestr += newformat;
 
+  // compression
+  if (newcompression && newcompression[0] != '\0') {
+    ofilestr += ".";
+    ofilestr += newcompression;
+  }
+
   return ofilestr;
 }
 
-CBFresponsee processfile(const CBFfrontend *frontend, const CBFbackend *backend, const CBFtransform *transform, const char *ifile, const char *ofile, bool verbose) {
+CBFresponsee processfile(const CBFfrontend *frontend, const CBFbackend *backend, const CBFtransform *transform, const char *ifile, const char *ofile, bool trustinput, bool verbose) {
   CBFresponsee res = CBF_RES_OK;
   CBFfrontendmemory mem = { 0, };
   CBFtransform_param param;
   CBFdata data = { 0, };
 
+  // Messages must not mix with output to standard output
+  FILE *log = CBF_isstdstream(ofile) ? stderr : stdout;
+  CBF_setmessagestream(log);
+
   // Read file
   if (verbose) {
-    printf("Reading %s\n", ifile);
+    fprintf(log, "Reading %s\n", ifile);
   }
-  res = frontend->read(ifile, &data, &mem);
+  res = frontend->read(ifile, &data, &mem, trustinput);
 
   if (res != CBF_RES_OK) {
-    printf("Failed to read file: %s\n", ifile);
+    fprintf(log, "Failed to read file: %s\n", ifile);
 
   } else {
     // Initialize parameters
@@ -237,17 +323,17 @@ CBFresponsee processfile(const CBFfrontend *frontend, const CBFbackend *backend,
     res = transform->transform(&data, param);
 
     if (res != CBF_RES_OK) {
-      printf("Failed to transform file: %s\n", ifile);
+      fprintf(log, "Failed to transform file: %s\n", ifile);
 
     } else {
       // Write file
       if (verbose) {
-        printf("Writing %s\n", ofile);
+        fprintf(log, "Writing %s\n", ofile);
       }
       res = backend->write(ofile, data);
 
       if (res != CBF_RES_OK)
-        printf("Failed to write file: %s\n", ofile);
+        fprintf(log, "Failed to write file: %s\n", ofile);
     }
 
     // Clean data structure
@@ -32,7 +32,9 @@ void printoptions(
     const CBFtransform **plugs_transform,
     const CBFfrontend   *default_frontend,
     const CBFbackend    *default_backend,
-    const CBFtransform  *default_transform);
+    const CBFtransform  *default_transform,
+    bool                 inputchecks,       // Offer -trust-input
+    bool                 streaming);        // Offer -stream
 
 CBFresponsee getoptions(int argc, char *argv[],
     const CBFfrontend  **plugs_frontend,
@@ -43,13 +45,19 @@ CBFresponsee getoptions(int argc, char *argv[],
     const CBFtransform **transform,
     const char         **opath,
     const char         **pfix,
+    const char         **compress,
+    int                 *threads,
+    bool                *trustinput,       // NULL if -trust-input is not offered
+    bool                *stream,           // NULL if -stream is not offered
+    bool                *inplacesort,
     bool                *verbose);
 
 const std::string swapfiledirandext(
     const char *ifile,
     const char *newpath,
     const char *newpostfix,
-    const char *newformat);
+    const char *newformat,
+    const char *newcompression);
 
 CBFresponsee processfile(
     const CBFfrontend  *frontend,
@@ -57,6 +65,7 @@ CBFresponsee processfile(
     const CBFtransform *transform,
     const char *ifile,
     const char *ofile,
+    const bool trustinput,
     const bool verbose);
 
 #endif
@@ -18,292 +18,1522 @@
 
 #include "frontend-cbf.h"
 #include "cbf-format.h"
+#include "cbf-thread.h"
+#include "cbf-stream.h"
+#include "cbf-lexer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * A row of the section index: a block starting with the line of keyword at
+ * the given byte offset, or (with keyword "+") the line of entry count of
+ * the coordinate block above.
+ */
+typedef struct CBFsection_struct {
+
+  char          keyword[CBF_MAX_NAME+1];
+  long long int offset;
+  long long int line;
+  long long int count;
+
+} CBFsection;
+
+/*
+ * The reader holds all parser state of a single call to the frontend, so
+ * any number of files can be parsed concurrently. Input is the buffered
+ * text [pos, end), which is either a whole memory mapped file or a block
+ * of a (possibly compressed) stream that is refilled when no complete line
+ * is left. The current line is the range [line, lineend) and is tokenized
+ * in place.
+ */
+typedef struct CBFreader_struct {
+
+  long long int linecount;
+  char          namebuf[CBF_MAX_NAME+1];    // CBF_NAME_FORMAT stores up to CBF_MAX_NAME chars plus '\0'
+
+  // Buffered input
+  const char *pos;
+  const char *end;
+  const char *line;
+  const char *lineend;
+  int         eof;
+
+  // Stream input
+  CBFstream      *pFile;
+  CBFblockreader *blocks;
+
+  // Memory mapped input
+  const char *map;
+  size_t      mapsize;
+
+  // Section index of memory mapped input (NULL if not available)
+  CBFsection   *sections;
+  long long int sectionnum;
+  long long int blockline;
+
+  // Event driven reading (NULL when the full CBFdata is materialized)
+  const CBFcallbacks *callbacks;
+
+  // Iteration over problems, stopping at each CHANGE keyword
+  int iterate;
+  int atchange;
+  long long int changes;
+
+  // Header-only reading, skipping the entries of coordinate blocks
+  int headeronly;
+
+  // Skips the range checks of indices in coordinate blocks
+  int trustinput;
+
+} CBFreader;
+
+/*
+ * Problems are read one by one from a single reader. A CHANGE block is
+ * parsed into a delta sharing the structure of the current problem, and
+ * its coordinates are then appended to those of the current problem.
+ */
+struct CBFproblemreader_struct {
+
+  CBFreader rd;
+  int       started;
+
+};
+
+typedef CBFresponsee (*CBFentryreader)(CBFreader *rd, CBFdata *data, long long int i);
+
+// Returns the first entry in [ibeg, iend) with indices out of range, or iend
+typedef long long int (*CBFentrychecker)(const CBFdata *data, long long int ibeg, long long int iend);
+
+/*
+ * From entry on, the lines of the entries of a block are shifted by this
+ * number of comment lines.
+ */
+typedef struct CBFlineshift_struct {
+
+  long long int entry;
+  long long int shift;
+
+} CBFlineshift;
+
+/*
+ * A range of entries [ibeg, iend) of a coordinate block, parsed by its
+ * own thread from its own reader positioned at the first line of the range.
+ */
+typedef struct CBFchunk_struct {
+
+  CBFreader       rd;
+  CBFdata        *data;
+  CBFentryreader  readentry;
+  CBFentrychecker checkentries;
+  long long int   ibeg;
+  long long int   iend;
+  const char     *begpos;     // Where rd started, to confirm the chunk before ended there
+  long long int   begline;
+  CBFresponsee    res;
 
-#ifndef ZLIB_SUPPORT
-typedef FILE CBFFILE;
-#define FOPEN(x,y) fopen(x,y)
-#define FCLOSE(x) fclose(x)
-#define FGETS(x,y,z) fgets(x,y,z)
-#else
-#include <zlib.h>
-typedef struct gzFile_s CBFFILE;
-#define FOPEN(x,y) gzopen(x,y)
-#define FCLOSE(x) gzclose(x)
-#define FGETS(x,y,z) gzgets(z,x,y)
-#endif
+} CBFchunk;
+
+// Smallest number of entries worth a thread of its own
+#define CBF_CHUNK_MINNNZ  16384
+
+// Default number of coordinates passed per callback in event driven reading
+#define CBF_BATCH_DEFAULT  4096
+
+// Entries checked at a time before looking for the first one out of range
+#define CBF_CHECK_STRIP  256
+
+static CBFresponsee
+  CBF_read(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
+
+static CBFresponsee
+  CBF_parsestream(CBFreader *rd, CBFdata *data, CBFfrontendmemory *mem);
+
+static long long int
+  CBF_readblock(void *pFile, char *buf, size_t len);
+
+static CBFresponsee
+  CBF_read_mmap(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
+
+static CBFresponsee
+  CBF_read_header(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
+
+static CBFresponsee
+  CBF_readbuffer(const char *buf, size_t len, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
+
+static CBFresponsee
+  CBF_readbuffer_header(const char *buf, size_t len, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
 
 static CBFresponsee
-  CBF_read(const char *file, CBFdata *data, CBFfrontendmemory *mem);
+  CBF_parsebuffer(CBFreader *rd, const char *buf, size_t len, CBFdata *data, CBFfrontendmemory *mem);
+
+static CBFresponsee
+  CBF_mapfile(const char *file, const char **map, size_t *mapsize);
+
+static CBFresponsee
+  CBF_loadsections(CBFreader *rd, const char *file);
+
+static long long int
+  CBF_findsection(const CBFreader *rd);
+
+static CBFresponsee
+  CBF_parse(CBFreader *rd, CBFdata *data, CBFfrontendmemory *mem);
+
+static CBFresponsee
+  CBF_parsekeyword(CBFreader *rd, CBFdata *data);
 
 static void
   CBF_clean(CBFdata *data, CBFfrontendmemory *mem);
 
+static void
+  CBF_cleancoordinates(CBFdata *data);
+
+static CBFresponsee
+  CBF_appendchange(CBFdata *data, CBFdata *delta);
+
+static CBFresponsee
+  CBF_appendarray(void **array, long long int num, const void *add, long long int addnum, size_t size);
+
+static CBFresponsee
+  CBF_fgets(CBFreader *rd);
+
+static int
+  CBF_iscoordinateblock(const char *keyword);
+
+static long long int
+  CBF_capacity(const CBFreader *rd, long long int nnz);
+
+static CBFresponsee
+  CBF_readentries(CBFreader *rd, CBFdata *data, long long int nnz, CBFentryreader readentry, CBFentrychecker checkentries);
+
 static CBFresponsee
-  CBF_fgets(CBFFILE *pFile, long long int *linecount);
+  CBF_skipentries(CBFreader *rd, long long int nnz);
+
+static void
+  CBF_marksorted(const CBFreader *rd, CBFdata *data, int blocks);
 
 static CBFresponsee
-  readVER(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  CBF_readentries_batched(CBFreader *rd, CBFdata *data, long long int nnz, CBFentryreader readentry, CBFentrychecker checkentries);
 
 static CBFresponsee
-  readOBJSENSE(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  CBF_readentries_serial(CBFreader *rd, CBFdata *data, long long int ibeg, long long int iend, long long int first, CBFentryreader readentry, CBFentrychecker checkentries);
 
 static CBFresponsee
-  readCON(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  CBF_readentries_parallel(CBFreader *rd, CBFdata *data, long long int nnz, CBFentryreader readentry, CBFentrychecker checkentries);
+
+static int
+  CBF_splitentries(CBFreader *rd, long long int nnz, CBFchunk *chunks, int numchunks);
+
+static int
+  CBF_splitentries_index(CBFreader *rd, long long int nnz, CBFchunk *chunks, int numchunks);
+
+static void
+  CBF_readentries_task(void *chunk);
+
+static long long int
+  CBF_checkrange(const long long int *sub, long long int ibeg, long long int iend, long long int num);
+
+static long long int
+  CBF_checkrange_int(const int *sub, long long int ibeg, long long int iend, int num);
+
+static long long int
+  CBF_checkdim(const int *subj, const int *subk, const int *dim, long long int ibeg, long long int iend);
+
+static int
+  CBF_sscanf(CBFreader *rd, const char *format, ...);
 
 static CBFresponsee
-  readVAR(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readVER(CBFreader *rd, CBFdata *data);
 
 static CBFresponsee
-  readINT(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readOBJSENSE(CBFreader *rd, CBFdata *data);
 
 static CBFresponsee
-  readPSDCON(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readCON(CBFreader *rd, CBFdata *data);
 
 static CBFresponsee
-  readPSDVAR(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readVAR(CBFreader *rd, CBFdata *data);
 
 static CBFresponsee
-  readOBJFCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readINT(CBFreader *rd, CBFdata *data);
 
 static CBFresponsee
-  readOBJACOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readPSDCON(CBFreader *rd, CBFdata *data);
 
 static CBFresponsee
-  readOBJBCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readPSDVAR(CBFreader *rd, CBFdata *data);
 
 static CBFresponsee
-  readFCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readOBJFCOORD(CBFreader *rd, CBFdata *data);
 
 static CBFresponsee
-  readACOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readOBJFCOORD_entry(CBFreader *rd, CBFdata *data, long long int i);
+
+static long long int
+  checkOBJFCOORD(const CBFdata *data, long long int ibeg, long long int iend);
 
 static CBFresponsee
-  readBCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readOBJACOORD(CBFreader *rd, CBFdata *data);
+
+static CBFresponsee
+  readOBJACOORD_entry(CBFreader *rd, CBFdata *data, long long int i);
+
+static long long int
+  checkOBJACOORD(const CBFdata *data, long long int ibeg, long long int iend);
+
+static CBFresponsee
+  readOBJBCOORD(CBFreader *rd, CBFdata *data);
+
+static CBFresponsee
+  readFCOORD(CBFreader *rd, CBFdata *data);
+
+static CBFresponsee
+  readFCOORD_entry(CBFreader *rd, CBFdata *data, long long int i);
+
+static long long int
+  checkFCOORD(const CBFdata *data, long long int ibeg, long long int iend);
+
+static CBFresponsee
+  readACOORD(CBFreader *rd, CBFdata *data);
+
+static CBFresponsee
+  readACOORD_entry(CBFreader *rd, CBFdata *data, long long int i);
+
+static long long int
+  checkACOORD(const CBFdata *data, long long int ibeg, long long int iend);
 
 static CBFresponsee
-  readHCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readBCOORD(CBFreader *rd, CBFdata *data);
 
 static CBFresponsee
-  readDCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data);
+  readBCOORD_entry(CBFreader *rd, CBFdata *data, long long int i);
+
+static long long int
+  checkBCOORD(const CBFdata *data, long long int ibeg, long long int iend);
+
+static CBFresponsee
+  readHCOORD(CBFreader *rd, CBFdata *data);
+
+static CBFresponsee
+  readHCOORD_entry(CBFreader *rd, CBFdata *data, long long int i);
+
+static long long int
+  checkHCOORD(const CBFdata *data, long long int ibeg, long long int iend);
+
+static CBFresponsee
+  readDCOORD(CBFreader *rd, CBFdata *data);
+
+static CBFresponsee
+  readDCOORD_entry(CBFreader *rd, CBFdata *data, long long int i);
+
+static long long int
+  checkDCOORD(const CBFdata *data, long long int ibeg, long long int iend);
 
 // -------------------------------------
 // Global variable
 // -------------------------------------
 
-CBFfrontend const frontend_cbf = { "cbf", CBF_read, CBF_clean };
+CBFfrontend const frontend_cbf = { "cbf", CBF_read, CBF_clean, CBF_readbuffer };
+CBFfrontend const frontend_cbf_mmap = { "cbf-mmap", CBF_read_mmap, CBF_clean, CBF_readbuffer };
+CBFfrontend const frontend_cbf_header = { "cbf-header", CBF_read_header, CBF_clean, CBF_readbuffer_header };
 
 
 // -------------------------------------
 // Function definitions
 // -------------------------------------
 
-static CBFresponsee CBF_read(const char *file, CBFdata *data, CBFfrontendmemory *mem) {
+static CBFresponsee CBF_read(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput) {
   CBFresponsee res = CBF_RES_OK;
-  long long int linecount = 0;
-  CBFFILE *pFile = NULL;
+  CBFreader rd = { 0, };
+  rd.trustinput = trustinput;
 
-  pFile = FOPEN(file, "rt");
-  if (!pFile) {
+  rd.pFile = CBF_openstream(file, "r");
+  if (!rd.pFile) {
     return CBF_RES_ERR;
   }
 
-  // Keyword OBJ should exist!
+  res = CBF_parsestream(&rd, data, mem);
+
+  CBF_closestream(rd.pFile);
+  return res;
+}
+
+static CBFresponsee CBF_read_mmap(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput) {
+  CBFresponsee res = CBF_RES_OK;
+  CBFreader rd = { 0, };
+  rd.trustinput = trustinput;
+
+  // Standard input can not be mapped
+  if (CBF_isstdstream(file)) {
+    return CBF_read(file, data, mem, trustinput);
+  }
+
+  if (CBF_mapfile(file, &rd.map, &rd.mapsize) != CBF_RES_OK) {
+    return CBF_RES_ERR;
+  }
+
+  rd.pos = rd.map;
+  rd.end = rd.map + rd.mapsize;
+  rd.eof = 1;
+
+  if (CBF_streamcompression(file) || (rd.mapsize >= 2 && (unsigned char)rd.map[0] == 0x1f && (unsigned char)rd.map[1] == 0x8b)) {
+    fprintf(CBF_messagestream(), "Memory mapped reading does not support compressed files.\n");
+    res = CBF_RES_ERR;
+  }
+
+  // Lets large blocks be split over threads without scanning them first
+  if (res == CBF_RES_OK && CBF_getthreads() >= 2)
+    CBF_loadsections(&rd, file);
+
+  if (res == CBF_RES_OK)
+    res = CBF_parse(&rd, data, mem);
+
+  free(rd.sections);
+  if (rd.map)
+    munmap((void*)rd.map, rd.mapsize);
+
+  return res;
+}
+
+CBFresponsee CBF_readsection(const char *file, const char *keyword, CBFdata *data) {
+  CBFresponsee res = CBF_RES_OK;
+  CBFreader rd = { 0, };
+  long long int s;
+
+  if (CBF_mapfile(file, &rd.map, &rd.mapsize) != CBF_RES_OK) {
+    return CBF_RES_ERR;
+  }
+
+  rd.end = rd.map + rd.mapsize;
+  rd.eof = 1;
+
+  if (CBF_loadsections(&rd, file) != CBF_RES_OK) {
+    fprintf(CBF_messagestream(), "Section index of %s is missing or does not match the file.\n", file);
+    res = CBF_RES_ERR;
+  }
+
   data->objsense = CBF_OBJ_END;
+  data->sorted = CBF_SORTED_ALL;   // No coordinates yet
+
+  // Information blocks are always read, coordinate blocks only if requested
+  for (s=0; s<rd.sectionnum && res==CBF_RES_OK; ++s) {
+    if (strcmp(rd.sections[s].keyword, "+") == 0 || strcmp(rd.sections[s].keyword, "END") == 0)
+      continue;
+
+    if (CBF_iscoordinateblock(rd.sections[s].keyword) && strcmp(rd.sections[s].keyword, keyword) != 0)
+      continue;
+
+    rd.pos = rd.map + rd.sections[s].offset;
+    rd.linecount = rd.sections[s].line - 1;
+
+    res = CBF_fgets(&rd);
+
+    if (res == CBF_RES_OK)
+      if (CBF_sscanf(&rd, CBF_NAME_FORMAT, rd.namebuf) != 1 || strcmp(rd.namebuf, rd.sections[s].keyword) != 0)
+        res = CBF_RES_ERR;
+
+    if (res == CBF_RES_OK)
+      res = CBF_parsekeyword(&rd, data);
+  }
+
+  if (res == CBF_RES_OK) {
+    if (data->objsense == CBF_OBJ_END) {
+      fprintf(CBF_messagestream(), "Keyword OBJSENSE is missing.\n");
+      res = CBF_RES_ERR;
+    }
+  }
+
+  if (res != CBF_RES_OK) {
+    if (rd.sections)
+      fprintf(CBF_messagestream(), "Failed to parse line: %lli\n", rd.linecount);
+    CBF_clean(data, NULL);
+  }
+
+  free(rd.sections);
+  if (rd.map)
+    munmap((void*)rd.map, rd.mapsize);
 
-  while( res==CBF_RES_OK && CBF_fgets(pFile, &linecount)==CBF_RES_OK )
+  return res;
+}
+
+static CBFresponsee CBF_read_header(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput) {
+  CBFresponsee res = CBF_RES_OK;
+  CBFreader rd = { 0, };
+
+  rd.pFile = CBF_openstream(file, "r");
+  if (!rd.pFile) {
+    return CBF_RES_ERR;
+  }
+  rd.headeronly = 1;
+
+  res = CBF_parsestream(&rd, data, mem);
+
+  CBF_closestream(rd.pFile);
+  return res;
+}
+
+static CBFresponsee CBF_readbuffer(const char *buf, size_t len, CBFdata *data, CBFfrontendmemory *mem, int trustinput) {
+  CBFreader rd = { 0, };
+  rd.trustinput = trustinput;
+
+  return CBF_parsebuffer(&rd, buf, len, data, mem);
+}
+
+static CBFresponsee CBF_readbuffer_header(const char *buf, size_t len, CBFdata *data, CBFfrontendmemory *mem, int trustinput) {
+  CBFreader rd = { 0, };
+  rd.headeronly = 1;
+
+  return CBF_parsebuffer(&rd, buf, len, data, mem);
+}
+
+// Parses the buffer in place, as if it was a memory mapped file
+static CBFresponsee CBF_parsebuffer(CBFreader *rd, const char *buf, size_t len, CBFdata *data, CBFfrontendmemory *mem) {
+  rd->map = buf;
+  rd->mapsize = len;
+  rd->pos = rd->map;
+  rd->end = rd->map + rd->mapsize;
+  rd->eof = 1;
+
+  if (len >= 2 && (unsigned char)buf[0] == 0x1f && (unsigned char)buf[1] == 0x8b) {
+    fprintf(CBF_messagestream(), "Reading from memory does not support compressed data.\n");
+    return CBF_RES_ERR;
+  }
+
+  return CBF_parse(rd, data, mem);
+}
+
+CBFresponsee CBF_checkcoordinates(const CBFdata *data) {
+  if (checkOBJFCOORD(data, 0, data->objfnnz) < data->objfnnz ||
+      checkOBJACOORD(data, 0, data->objannz) < data->objannz ||
+      checkFCOORD(data, 0, data->fnnz) < data->fnnz ||
+      checkACOORD(data, 0, data->annz) < data->annz ||
+      checkBCOORD(data, 0, data->bnnz) < data->bnnz ||
+      checkHCOORD(data, 0, data->hnnz) < data->hnnz ||
+      checkDCOORD(data, 0, data->dnnz) < data->dnnz)
+    return CBF_RES_ERR;
+
+  return CBF_RES_OK;
+}
+
+CBFresponsee CBF_readstream(const char *file, const CBFcallbacks *callbacks) {
+  CBFresponsee res = CBF_RES_OK;
+  CBFreader rd = { 0, };
+  CBFdata data = { 0, };
+
+  rd.pFile = CBF_openstream(file, "r");
+  if (!rd.pFile) {
+    return CBF_RES_ERR;
+  }
+  rd.callbacks = callbacks;
+  rd.trustinput = callbacks->trustinput;
+
+  // Cleans up by itself on failure
+  res = CBF_parsestream(&rd, &data, NULL);
+
+  if (res == CBF_RES_OK)
+    CBF_clean(&data, NULL);
+
+  CBF_closestream(rd.pFile);
+  return res;
+}
+
+CBFproblemreader * CBF_openproblems(const char *file, int trustinput) {
+  CBFproblemreader *pr;
+
+  pr = (CBFproblemreader*) calloc(1, sizeof(*pr));
+  if (!pr) {
+    return NULL;
+  }
+
+  pr->rd.pFile = CBF_openstream(file, "r");
+  if (pr->rd.pFile) {
+    pr->rd.blocks = CBF_openblockreader(CBF_readblock, pr->rd.pFile, CBF_getthreads() >= 2);
+    if (!pr->rd.blocks)
+      CBF_closestream(pr->rd.pFile);
+  }
+
+  if (!pr->rd.pFile || !pr->rd.blocks) {
+    free(pr);
+    return NULL;
+  }
+
+  pr->rd.iterate = 1;
+  pr->rd.trustinput = trustinput;
+  return pr;
+}
+
+CBFresponsee CBF_nextproblem(CBFproblemreader *pr, CBFdata *data, int *found) {
+  CBFresponsee res = CBF_RES_OK;
+  CBFdata delta;
+
+  *found = 0;
+
+  if (!pr->started) {
+    pr->started = 1;
+    res = CBF_parse(&pr->rd, data, NULL);
+
+  } else if (pr->rd.atchange) {
+    pr->rd.atchange = 0;
+    ++(pr->rd.changes);
+
+    // The delta shares the structure of data, but has coordinates of its own
+    memset(&delta, 0, sizeof(delta));
+    delta.ver            = data->ver;
+    delta.objsense       = data->objsense;
+    delta.mapnum         = data->mapnum;
+    delta.mapstacknum    = data->mapstacknum;
+    delta.mapstackdim    = data->mapstackdim;
+    delta.mapstackdomain = data->mapstackdomain;
+    delta.varnum         = data->varnum;
+    delta.varstacknum    = data->varstacknum;
+    delta.varstackdim    = data->varstackdim;
+    delta.varstackdomain = data->varstackdomain;
+    delta.intvarnum      = data->intvarnum;
+    delta.intvar         = data->intvar;
+    delta.psdmapnum      = data->psdmapnum;
+    delta.psdmapdim      = data->psdmapdim;
+    delta.psdvarnum      = data->psdvarnum;
+    delta.psdvardim      = data->psdvardim;
+    delta.objbval        = data->objbval;
+
+    res = CBF_parse(&pr->rd, &delta, NULL);
+
+    if (res == CBF_RES_OK)
+      res = CBF_appendchange(data, &delta);
+
+  } else {
+    return CBF_RES_OK;
+  }
+
+  if (res == CBF_RES_OK)
+    *found = 1;
+
+  return res;
+}
+
+void CBF_closeproblems(CBFproblemreader *pr) {
+  CBF_closeblockreader(pr->rd.blocks);
+  CBF_closestream(pr->rd.pFile);
+  free(pr);
+}
+
+static CBFresponsee CBF_parsestream(CBFreader *rd, CBFdata *data, CBFfrontendmemory *mem) {
+  CBFresponsee res = CBF_RES_OK;
+
+  // Reading (and inflating) input on a thread of its own overlaps with parsing
+  rd->blocks = CBF_openblockreader(CBF_readblock, rd->pFile, CBF_getthreads() >= 2);
+  if (!rd->blocks) {
+    return CBF_RES_ERR;
+  }
+
+  res = CBF_parse(rd, data, mem);
+
+  CBF_closeblockreader(rd->blocks);
+  return res;
+}
+
+static long long int CBF_readblock(void *pFile, char *buf, size_t len) {
+  return CBF_streamread((CBFstream*)pFile, buf, len);
+}
+
+static CBFresponsee CBF_mapfile(const char *file, const char **map, size_t *mapsize) {
+  struct stat st;
+  void *addr = NULL;
+  int fd;
+
+  if (CBF_isstdstream(file)) {
+    return CBF_RES_ERR;
+  }
+
+  fd = open(file, O_RDONLY);
+  if (fd == -1) {
+    return CBF_RES_ERR;
+  }
+
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return CBF_RES_ERR;
+  }
+
+  // Empty files are valid input (and can not be mapped)
+  if (st.st_size >= 1) {
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      return CBF_RES_ERR;
+    }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  *map = (const char*) addr;
+  *mapsize = st.st_size;
+  return CBF_RES_OK;
+}
+
+/*
+ * Loads the section index written next to the file by backend_cbf_index,
+ * provided it matches the memory mapped file: rows in order of offset,
+ * each at the start of a line of the file, and ending at its END.
+ */
+static CBFresponsee CBF_loadsections(CBFreader *rd, const char *file) {
+  CBFresponsee res = CBF_RES_OK;
+  CBFreader ird = { 0, };
+  CBFsection *row, *grown;
+  long long int capacity = 0;
+  char *indexfile;
+
+  indexfile = (char*) malloc(strlen(file) + strlen(CBF_SECTION_EXTENSION) + 1);
+  if (!indexfile) {
+    return CBF_RES_ERR;
+  }
+
+  strcpy(indexfile, file);
+  strcat(indexfile, CBF_SECTION_EXTENSION);
+  ird.pFile = CBF_openstream(indexfile, "r");
+  free(indexfile);
+
+  if (!ird.pFile) {
+    return CBF_RES_ERR;
+  }
+
+  ird.blocks = CBF_openblockreader(CBF_readblock, ird.pFile, 0);
+  if (!ird.blocks) {
+    CBF_closestream(ird.pFile);
+    return CBF_RES_ERR;
+  }
+
+  while (res == CBF_RES_OK && CBF_fgets(&ird) == CBF_RES_OK) {
+    if (rd->sectionnum == capacity) {
+      capacity = (capacity >= 1) ? 2*capacity : 32;
+      grown = (CBFsection*) realloc(rd->sections, capacity * sizeof(rd->sections[0]));
+      if (!grown) {
+        res = CBF_RES_ERR;
+        break;
+      }
+      rd->sections = grown;
+    }
+
+    row = &rd->sections[rd->sectionnum];
+    switch (CBF_sscanf(&ird, CBF_NAME_FORMAT " %lli %lli %lli", row->keyword, &row->offset, &row->line, &row->count)) {
+    case EOF:
+      continue;
+    case 4:
+      break;
+    default:
+      res = CBF_RES_ERR;
+      continue;
+    }
+
+    if (row->offset < 0 || (size_t)row->offset > rd->mapsize || row->line < 1 || row->count < 0)
+      res = CBF_RES_ERR;
+
+    else if (rd->sectionnum >= 1 && (row->offset < row[-1].offset || row->line < row[-1].line))
+      res = CBF_RES_ERR;
+
+    else if (row->offset >= 1 && rd->map[row->offset - 1] != '\n')
+      res = CBF_RES_ERR;
+
+    ++(rd->sectionnum);
+  }
+
+  if (res == CBF_RES_OK)
+    if (rd->sectionnum == 0 || strcmp(rd->sections[rd->sectionnum-1].keyword, "END") != 0 ||
+        (size_t)rd->sections[rd->sectionnum-1].offset != rd->mapsize)
+      res = CBF_RES_ERR;
+
+  CBF_closeblockreader(ird.blocks);
+  CBF_closestream(ird.pFile);
+
+  if (res != CBF_RES_OK) {
+    free(rd->sections);
+    rd->sections = NULL;
+    rd->sectionnum = 0;
+  }
+
+  return res;
+}
+
+// Row of the section index of the current block, or -1 if there is none
+static long long int CBF_findsection(const CBFreader *rd) {
+  long long int s;
+
+  for (s=0; s<rd->sectionnum; ++s)
+    if (rd->sections[s].line == rd->blockline && strcmp(rd->sections[s].keyword, rd->namebuf) == 0)
+      return s;
+
+  return -1;
+}
+
+static CBFresponsee CBF_parse(CBFreader *rd, CBFdata *data, CBFfrontendmemory *mem) {
+  CBFresponsee res = CBF_RES_OK;
+
+  // Keyword OBJ should exist!
+  if (rd->changes == 0) {
+    data->objsense = CBF_OBJ_END;
+    data->sorted = CBF_SORTED_ALL;   // No coordinates yet
+  }
+
+  while( res==CBF_RES_OK && !rd->atchange && CBF_fgets(rd)==CBF_RES_OK )
   {
     // Parse keyword on non-empty lines
-    if ( sscanf(CBF_LINE_BUFFER, CBF_NAME_FORMAT, CBF_NAME_BUFFER)==1 )
+    if ( CBF_sscanf(rd, CBF_NAME_FORMAT, rd->namebuf)==1 )
     {
+      res = CBF_parsekeyword(rd, data);
 
-      if (data->ver == 0) {
+//      // Information blocks are terminated by an empty line
+//      if ( res==CBF_RES_OK ) {
+//        if ( CBF_fgets(rd)==CBF_RES_OK ) {
+//          if ( CBF_sscanf(rd, CBF_NAME_FORMAT, rd->namebuf)!=EOF ) {
+//            printf("An empty line was expected, found: %s\n", rd->namebuf);
+//            res = CBF_RES_ERR;
+//          }
+//        }
+//      }
+    }
+  }
 
-        if (strcmp(CBF_NAME_BUFFER, "VER") == 0)
-          res = readVER(pFile, &linecount, data);
+  if (res == CBF_RES_OK) {
+    if (data->objsense == CBF_OBJ_END) {
+      fprintf(CBF_messagestream(), "Keyword OBJSENSE is missing.\n");
+      res = CBF_RES_ERR;
+    }
+  }
 
-        else {
-          printf("First keyword should be VER.\n");
-          res = CBF_RES_ERR;
-        }
+  if (res != CBF_RES_OK) {
+    fprintf(CBF_messagestream(), "Failed to parse line: %lli\n", rd->linecount);
 
-      } else {
+    // A delta only owns its coordinates
+    if (rd->changes >= 1)
+      CBF_cleancoordinates(data);
+    else
+      CBF_clean(data, mem);
+  }
+
+  return res;
+}
+
+static CBFresponsee CBF_parsekeyword(CBFreader *rd, CBFdata *data)
+{
+  CBFresponsee res = CBF_RES_OK;
+  char keyword[CBF_MAX_NAME+1];
+
+  // Blocks such as OBJSENSE reuse namebuf for their values
+  strcpy(keyword, rd->namebuf);
+
+  // Coordinate blocks are located in the section index by this line
+  rd->blockline = rd->linecount;
+
+  if (rd->changes >= 1 && !CBF_iscoordinateblock(rd->namebuf) &&
+      strcmp(rd->namebuf, "OBJBCOORD") != 0 && strcmp(rd->namebuf, "CHANGE") != 0) {
+    fprintf(CBF_messagestream(), "Keyword %s is not allowed after CHANGE.\n", rd->namebuf);
+    res = CBF_RES_ERR;
+
+  } else if (data->ver == 0) {
+
+    if (strcmp(rd->namebuf, "VER") == 0)
+      res = readVER(rd, data);
+
+    else {
+      fprintf(CBF_messagestream(), "First keyword should be VER.\n");
+      res = CBF_RES_ERR;
+    }
+
+  } else {
+
+    if (strcmp(rd->namebuf, "OBJSENSE") == 0)
+      res = readOBJSENSE(rd, data);
+
+    else if (strcmp(rd->namebuf, "CON") == 0)
+      res = readCON(rd, data);
+
+    else if (strcmp(rd->namebuf, "VAR") == 0)
+      res = readVAR(rd, data);
+
+    else if (strcmp(rd->namebuf, "INT") == 0)
+      res = readINT(rd, data);
+
+    else if (strcmp(rd->namebuf, "PSDCON") == 0)
+      res = readPSDCON(rd, data);
+
+    else if (strcmp(rd->namebuf, "PSDVAR") == 0)
+      res = readPSDVAR(rd, data);
+
+    else if (strcmp(rd->namebuf, "OBJFCOORD") == 0)
+      res = readOBJFCOORD(rd, data);
+
+    else if (strcmp(rd->namebuf, "OBJACOORD") == 0)
+      res = readOBJACOORD(rd, data);
+
+    else if (strcmp(rd->namebuf, "OBJBCOORD") == 0)
+      res = readOBJBCOORD(rd, data);
+
+    else if (strcmp(rd->namebuf, "FCOORD") == 0)
+      res = readFCOORD(rd, data);
+
+    else if (strcmp(rd->namebuf, "ACOORD") == 0)
+      res = readACOORD(rd, data);
+
+    else if (strcmp(rd->namebuf, "BCOORD") == 0)
+      res = readBCOORD(rd, data);
+
+    else if (strcmp(rd->namebuf, "HCOORD") == 0)
+      res = readHCOORD(rd, data);
+
+    else if (strcmp(rd->namebuf, "DCOORD") == 0)
+      res = readDCOORD(rd, data);
+
+    else if (strcmp(rd->namebuf, "CHANGE") == 0 && rd->iterate)
+      rd->atchange = 1;
+
+    else if (strcmp(rd->namebuf, "CHANGE") == 0) {
+      fprintf(CBF_messagestream(), "Keyword CHANGE is only supported when iterating over problems.\n");
+      res = CBF_RES_ERR;
+    }
+
+    else {
+      fprintf(CBF_messagestream(), "Keyword %s not recognized!\n", rd->namebuf);
+      res = CBF_RES_ERR;
+    }
+  }
+
+  // Information blocks are reported as a whole (coordinates in batches)
+  if (res == CBF_RES_OK && rd->callbacks && rd->callbacks->block)
+    if (!CBF_iscoordinateblock(keyword))
+      res = rd->callbacks->block(rd->callbacks->handle, keyword, data);
+
+  return res;
+}
+
+static void CBF_clean(CBFdata *data, CBFfrontendmemory *mem) {
+  if (data->mapstacknum >= 1) {
+    free(data->mapstackdim);
+    free(data->mapstackdomain);
+  }
+
+  if (data->varstacknum >= 1) {
+    free(data->varstackdim);
+    free(data->varstackdomain);
+  }
+
+  if (data->intvarnum >= 1) {
+    free(data->intvar);
+  }
+
+  if (data->psdmapnum >= 1) {
+    free(data->psdmapdim);
+  }
+
+  if (data->psdvarnum >= 1) {
+    free(data->psdvardim);
+  }
+
+  CBF_cleancoordinates(data);
+}
+
+static void CBF_cleancoordinates(CBFdata *data) {
+  if (data->objfnnz >= 1) {
+    free(data->objfsubj);
+    free(data->objfsubk);
+    free(data->objfsubl);
+    free(data->objfval);
+  }
+
+  if (data->objannz >= 1) {
+    free(data->objasubj);
+    free(data->objaval);
+  }
+
+  if (data->fnnz >= 1) {
+    free(data->fsubi);
+    free(data->fsubj);
+    free(data->fsubk);
+    free(data->fsubl);
+    free(data->fval);
+  }
+
+  if (data->annz >= 1) {
+    free(data->asubi);
+    free(data->asubj);
+    free(data->aval);
+  }
+
+  if (data->bnnz >= 1) {
+    free(data->bsubi);
+    free(data->bval);
+  }
+
+  if (data->hnnz >= 1) {
+    free(data->hsubi);
+    free(data->hsubj);
+    free(data->hsubk);
+    free(data->hsubl);
+    free(data->hval);
+  }
+
+  if (data->dnnz >= 1) {
+    free(data->dsubi);
+    free(data->dsubk);
+    free(data->dsubl);
+    free(data->dval);
+  }
+}
+
+static CBFresponsee CBF_appendchange(CBFdata *data, CBFdata *delta)
+{
+  CBFresponsee res = CBF_RES_OK;
+  int changed = CBF_SORTED_NONE;
+  int sorted;
+
+  // Blocks with new coordinates stay sorted if both parts were, and they meet in order
+  if (delta->objannz >= 1)
+    changed |= CBF_SORTED_OBJA;
+
+  if (delta->fnnz >= 1)
+    changed |= CBF_SORTED_F;
+
+  if (delta->annz >= 1)
+    changed |= CBF_SORTED_A | CBF_SORTED_ACOL;
+
+  if (delta->bnnz >= 1)
+    changed |= CBF_SORTED_B;
+
+  if (delta->hnnz >= 1)
+    changed |= CBF_SORTED_H;
+
+  if (delta->dnnz >= 1)
+    changed |= CBF_SORTED_D;
+
+  sorted = (data->sorted & ~changed) | CBF_findsortedappend(data, delta, data->sorted & delta->sorted & changed);
+
+  data->objbval = delta->objbval;
+
+  if (res == CBF_RES_OK && delta->objfnnz >= 1) {
+    res = CBF_appendarray((void**)&data->objfsubj, data->objfnnz, delta->objfsubj, delta->objfnnz, sizeof(data->objfsubj[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->objfsubk, data->objfnnz, delta->objfsubk, delta->objfnnz, sizeof(data->objfsubk[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->objfsubl, data->objfnnz, delta->objfsubl, delta->objfnnz, sizeof(data->objfsubl[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->objfval, data->objfnnz, delta->objfval, delta->objfnnz, sizeof(data->objfval[0]));
+    if (res == CBF_RES_OK)
+      data->objfnnz += delta->objfnnz;
+  }
+
+  if (res == CBF_RES_OK && delta->objannz >= 1) {
+    res = CBF_appendarray((void**)&data->objasubj, data->objannz, delta->objasubj, delta->objannz, sizeof(data->objasubj[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->objaval, data->objannz, delta->objaval, delta->objannz, sizeof(data->objaval[0]));
+    if (res == CBF_RES_OK)
+      data->objannz += delta->objannz;
+  }
+
+  if (res == CBF_RES_OK && delta->fnnz >= 1) {
+    res = CBF_appendarray((void**)&data->fsubi, data->fnnz, delta->fsubi, delta->fnnz, sizeof(data->fsubi[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->fsubj, data->fnnz, delta->fsubj, delta->fnnz, sizeof(data->fsubj[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->fsubk, data->fnnz, delta->fsubk, delta->fnnz, sizeof(data->fsubk[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->fsubl, data->fnnz, delta->fsubl, delta->fnnz, sizeof(data->fsubl[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->fval, data->fnnz, delta->fval, delta->fnnz, sizeof(data->fval[0]));
+    if (res == CBF_RES_OK)
+      data->fnnz += delta->fnnz;
+  }
+
+  if (res == CBF_RES_OK && delta->annz >= 1) {
+    res = CBF_appendarray((void**)&data->asubi, data->annz, delta->asubi, delta->annz, sizeof(data->asubi[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->asubj, data->annz, delta->asubj, delta->annz, sizeof(data->asubj[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->aval, data->annz, delta->aval, delta->annz, sizeof(data->aval[0]));
+    if (res == CBF_RES_OK)
+      data->annz += delta->annz;
+  }
+
+  if (res == CBF_RES_OK && delta->bnnz >= 1) {
+    res = CBF_appendarray((void**)&data->bsubi, data->bnnz, delta->bsubi, delta->bnnz, sizeof(data->bsubi[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->bval, data->bnnz, delta->bval, delta->bnnz, sizeof(data->bval[0]));
+    if (res == CBF_RES_OK)
+      data->bnnz += delta->bnnz;
+  }
+
+  if (res == CBF_RES_OK && delta->hnnz >= 1) {
+    res = CBF_appendarray((void**)&data->hsubi, data->hnnz, delta->hsubi, delta->hnnz, sizeof(data->hsubi[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->hsubj, data->hnnz, delta->hsubj, delta->hnnz, sizeof(data->hsubj[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->hsubk, data->hnnz, delta->hsubk, delta->hnnz, sizeof(data->hsubk[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->hsubl, data->hnnz, delta->hsubl, delta->hnnz, sizeof(data->hsubl[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->hval, data->hnnz, delta->hval, delta->hnnz, sizeof(data->hval[0]));
+    if (res == CBF_RES_OK)
+      data->hnnz += delta->hnnz;
+  }
+
+  if (res == CBF_RES_OK && delta->dnnz >= 1) {
+    res = CBF_appendarray((void**)&data->dsubi, data->dnnz, delta->dsubi, delta->dnnz, sizeof(data->dsubi[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->dsubk, data->dnnz, delta->dsubk, delta->dnnz, sizeof(data->dsubk[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->dsubl, data->dnnz, delta->dsubl, delta->dnnz, sizeof(data->dsubl[0]));
+    if (res == CBF_RES_OK)
+      res = CBF_appendarray((void**)&data->dval, data->dnnz, delta->dval, delta->dnnz, sizeof(data->dval[0]));
+    if (res == CBF_RES_OK)
+      data->dnnz += delta->dnnz;
+  }
+
+  if (res == CBF_RES_OK)
+    data->sorted = sorted;
+  else
+    data->sorted = CBF_SORTED_NONE;
+
+  CBF_cleancoordinates(delta);
+  return res;
+}
+
+static CBFresponsee CBF_appendarray(void **array, long long int num, const void *add, long long int addnum, size_t size)
+{
+  void *grown;
+
+  // Arrays of empty blocks may not have been allocated
+  grown = realloc((num >= 1) ? *array : NULL, (num + addnum) * size);
+  if (!grown)
+    return CBF_RES_ERR;
 
-        if (strcmp(CBF_NAME_BUFFER, "OBJSENSE") == 0)
-          res = readOBJSENSE(pFile, &linecount, data);
+  memcpy((char*)grown + num*size, add, addnum*size);
+  *array = grown;
+  return CBF_RES_OK;
+}
+
+static CBFresponsee CBF_fgets(CBFreader *rd)
+{
+  const char *eol;
+
+  // Find first non-commentary line
+  while( rd->pos < rd->end || !rd->eof ) {
+    eol = CBF_lexnewline(rd->pos, rd->end);
+
+    // Complete the last line of the block from the next block
+    if (!eol && !rd->eof) {
+      if (CBF_nextblock(rd->blocks, rd->pos, rd->end - rd->pos, &rd->pos, &rd->end, &rd->eof) != CBF_RES_OK)
+        return CBF_RES_ERR;
+      continue;
+    }
+
+    if (!eol)
+      eol = rd->end;
+
+    ++(rd->linecount);
+
+    rd->line = rd->pos;
+    rd->lineend = eol;
+    rd->pos = (eol < rd->end) ? eol + 1 : eol;
+
+    if (rd->line == rd->lineend || rd->line[0] != '#')
+      return CBF_RES_OK;
+  }
+
+  return CBF_RES_ERR;
+}
+
+static int CBF_iscoordinateblock(const char *keyword)
+{
+  static const char *coordinateblocks[] = {"OBJFCOORD", "OBJACOORD", "FCOORD", "ACOORD", "BCOORD", "HCOORD", "DCOORD", NULL};
+  int k;
+
+  for (k=0; coordinateblocks[k]; ++k)
+    if (strcmp(keyword, coordinateblocks[k]) == 0)
+      return 1;
+
+  return 0;
+}
+
+static long long int CBF_capacity(const CBFreader *rd, long long int nnz)
+{
+  long long int batchsize;
+
+  // Header-only reading keeps no coordinates at all
+  if (rd->headeronly)
+    return 0;
+
+  // Event driven reading only keeps a batch of coordinates in memory
+  if (rd->callbacks) {
+    batchsize = (rd->callbacks->batchsize >= 1) ? rd->callbacks->batchsize : CBF_BATCH_DEFAULT;
+    if (nnz > batchsize)
+      return batchsize;
+  }
+
+  return nnz;
+}
+
+static CBFresponsee CBF_readentries(CBFreader *rd, CBFdata *data, long long int nnz, CBFentryreader readentry, CBFentrychecker checkentries)
+{
+  if (rd->headeronly)
+    return CBF_skipentries(rd, nnz);
+
+  if (rd->callbacks)
+    return CBF_readentries_batched(rd, data, nnz, readentry, checkentries);
+
+  // Large blocks of memory mapped input are split over several threads
+  if (rd->map && nnz >= 2*CBF_CHUNK_MINNNZ && CBF_getthreads() >= 2)
+    return CBF_readentries_parallel(rd, data, nnz, readentry, checkentries);
+
+  return CBF_readentries_serial(rd, data, 0, nnz, 0, readentry, checkentries);
+}
+
+static CBFresponsee CBF_skipentries(CBFreader *rd, long long int nnz)
+{
+  long long int i;
+
+  // Entries are only counted by their line breaks, not parsed
+  for (i=0; i<nnz; ++i)
+    if (CBF_fgets(rd) != CBF_RES_OK)
+      return CBF_RES_ERR;
+
+  return CBF_RES_OK;
+}
+
+// Records which of the blocks just read are sorted, sparing later sorts
+static void CBF_marksorted(const CBFreader *rd, CBFdata *data, int blocks)
+{
+  data->sorted &= ~blocks;
+
+  // Skipped entries and entries reported in batches are never held in full
+  if (!rd->headeronly && !rd->callbacks)
+    data->sorted |= CBF_findsorted(data, blocks);
+}
+
+static CBFresponsee CBF_readentries_batched(CBFreader *rd, CBFdata *data, long long int nnz, CBFentryreader readentry, CBFentrychecker checkentries)
+{
+  CBFresponsee res = CBF_RES_OK;
+  long long int first, count, batchsize = CBF_capacity(rd, nnz);
 
-        else if (strcmp(CBF_NAME_BUFFER, "CON") == 0)
-          res = readCON(pFile, &linecount, data);
+  // The keyword of the block is still in namebuf
+  for (first=0; first<nnz && res==CBF_RES_OK; first+=count) {
+    count = (nnz - first < batchsize) ? nnz - first : batchsize;
 
-        else if (strcmp(CBF_NAME_BUFFER, "VAR") == 0)
-          res = readVAR(pFile, &linecount, data);
+    res = CBF_readentries_serial(rd, data, first, first + count, first, readentry, checkentries);
 
-        else if (strcmp(CBF_NAME_BUFFER, "INT") == 0)
-          res = readINT(pFile, &linecount, data);
+    if (res == CBF_RES_OK && rd->callbacks->coordinates)
+      res = rd->callbacks->coordinates(rd->callbacks->handle, rd->namebuf, data, first, count);
+  }
 
-        else if (strcmp(CBF_NAME_BUFFER, "PSDCON") == 0)
-          res = readPSDCON(pFile, &linecount, data);
+  return res;
+}
 
-        else if (strcmp(CBF_NAME_BUFFER, "PSDVAR") == 0)
-          res = readPSDVAR(pFile, &linecount, data);
+/*
+ * Reads entries [ibeg, iend) of a block into index i - first of its arrays,
+ * and checks their indices afterwards in a single pass over the arrays (the
+ * earliest failure is reported, be it a line that could not be parsed or
+ * indices out of range). The line of an entry follows from the line of the
+ * first entry and the comment lines skipped in between.
+ */
+static CBFresponsee CBF_readentries_serial(CBFreader *rd, CBFdata *data, long long int ibeg, long long int iend, long long int first, CBFentryreader readentry, CBFentrychecker checkentries)
+{
+  CBFresponsee res = CBF_RES_OK;
+  CBFlineshift *shifts = NULL, *grown;
+  long long int i, iread, bad, line, shift = 0, numshifts = 0;
+
+  line = rd->linecount + 1;
+  for (i=ibeg; i<iend && res==CBF_RES_OK; ++i) {
+    res = CBF_fgets(rd);
+
+    if (res == CBF_RES_OK && rd->linecount != line + (i - ibeg) + shift) {
+      shift = rd->linecount - line - (i - ibeg);
+
+      grown = (CBFlineshift*) realloc(shifts, (numshifts + 1) * sizeof(shifts[0]));
+      if (grown) {
+        shifts = grown;
+        shifts[numshifts].entry = i;
+        shifts[numshifts].shift = shift;
+        ++numshifts;
+      } else {
+        res = CBF_RES_ERR;
+      }
+    }
 
-        else if (strcmp(CBF_NAME_BUFFER, "OBJFCOORD") == 0)
-          res = readOBJFCOORD(pFile, &linecount, data);
+    if (res == CBF_RES_OK)
+      res = readentry(rd, data, i - first);
+  }
 
-        else if (strcmp(CBF_NAME_BUFFER, "OBJACOORD") == 0)
-          res = readOBJACOORD(pFile, &linecount, data);
+  // Entries before the one that failed, if any, were read
+  iread = (res == CBF_RES_OK) ? iend : i - 1;
 
-        else if (strcmp(CBF_NAME_BUFFER, "OBJBCOORD") == 0)
-          res = readOBJBCOORD(pFile, &linecount, data);
+  if (!rd->trustinput) {
+    bad = checkentries(data, ibeg - first, iread - first) + first;
 
-        else if (strcmp(CBF_NAME_BUFFER, "FCOORD") == 0)
-          res = readFCOORD(pFile, &linecount, data);
+    if (bad < iread) {
+      for (shift = 0; numshifts >= 1 && shifts[numshifts-1].entry > bad; --numshifts);
+      if (numshifts >= 1)
+        shift = shifts[numshifts-1].shift;
 
-        else if (strcmp(CBF_NAME_BUFFER, "ACOORD") == 0)
-          res = readACOORD(pFile, &linecount, data);
+      rd->linecount = line + (bad - ibeg) + shift;
+      res = CBF_RES_ERR;
+    }
+  }
 
-        else if (strcmp(CBF_NAME_BUFFER, "BCOORD") == 0)
-          res = readBCOORD(pFile, &linecount, data);
+  free(shifts);
+  return res;
+}
 
-        else if (strcmp(CBF_NAME_BUFFER, "HCOORD") == 0)
-          res = readHCOORD(pFile, &linecount, data);
+static CBFresponsee CBF_readentries_parallel(CBFreader *rd, CBFdata *data, long long int nnz, CBFentryreader readentry, CBFentrychecker checkentries)
+{
+  CBFresponsee res = CBF_RES_OK;
+  CBFchunk *chunks;
+  int c, maxchunks, numchunks;
+
+  maxchunks = CBF_getthreads();
+  if (maxchunks > nnz / CBF_CHUNK_MINNNZ)
+    maxchunks = (int) (nnz / CBF_CHUNK_MINNNZ);
+
+  chunks = (CBFchunk*) calloc(maxchunks, sizeof(chunks[0]));
+  if (!chunks)
+    return CBF_readentries_serial(rd, data, 0, nnz, 0, readentry, checkentries);
+
+  // The section index tells where the chunks begin, otherwise they are searched for
+  numchunks = CBF_splitentries_index(rd, nnz, chunks, maxchunks);
+  if (numchunks == 0)
+    numchunks = CBF_splitentries(rd, nnz, chunks, maxchunks);
+
+  // Truncated blocks are left to the serial reader for error reporting
+  if (numchunks == 0) {
+    free(chunks);
+    return CBF_readentries_serial(rd, data, 0, nnz, 0, readentry, checkentries);
+  }
 
-        else if (strcmp(CBF_NAME_BUFFER, "DCOORD") == 0)
-          res = readDCOORD(pFile, &linecount, data);
+  for (c=0; c<numchunks; ++c) {
+    chunks[c].rd.map = rd->map;
+    chunks[c].rd.mapsize = rd->mapsize;
+    chunks[c].rd.end = rd->end;
+    chunks[c].rd.eof = 1;
+    chunks[c].rd.trustinput = rd->trustinput;
+    chunks[c].data = data;
+    chunks[c].readentry = readentry;
+    chunks[c].checkentries = checkentries;
+    chunks[c].iend = (c+1 < numchunks) ? chunks[c+1].ibeg : nnz;
+    chunks[c].begpos = chunks[c].rd.pos;
+    chunks[c].begline = chunks[c].rd.linecount;
+  }
 
-        else {
-          printf("Keyword %s not recognized!\n", CBF_NAME_BUFFER);
-          res = CBF_RES_ERR;
-        }
-      }
+  CBF_runtasks(numchunks, CBF_readentries_task, chunks, sizeof(chunks[0]));
 
-//      // Information blocks are terminated by an empty line
-//      if ( res==CBF_RES_OK ) {
-//        if ( CBF_fgets(pFile, &linecount)==CBF_RES_OK ) {
-//          if ( sscanf(CBF_LINE_BUFFER, CBF_NAME_FORMAT, CBF_NAME_BUFFER)!=EOF ) {
-//            printf("An empty line was expected, found: %s\n", CBF_NAME_BUFFER);
-//            res = CBF_RES_ERR;
-//          }
-//        }
-//      }
+  // Each chunk must end where the next one began. A stale section index may
+  // still point at line starts, and then entries would be skipped or read twice.
+  for (c=0; c+1<numchunks; ++c) {
+    if (chunks[c].rd.pos != chunks[c+1].begpos || chunks[c].rd.linecount != chunks[c+1].begline) {
+      free(chunks);
+      return CBF_readentries_serial(rd, data, 0, nnz, 0, readentry, checkentries);
     }
   }
 
-  if (res == CBF_RES_OK) {
-    if (data->objsense == CBF_OBJ_END) {
-      printf("Keyword OBJSENSE is missing.\n");
+  // Report the first failing line, as the serial reader would have done
+  for (c=0; c<numchunks && res==CBF_RES_OK; ++c) {
+    if (chunks[c].res != CBF_RES_OK) {
+      rd->linecount = chunks[c].rd.linecount;
       res = CBF_RES_ERR;
     }
   }
 
-  if (res != CBF_RES_OK) {
-    printf("Failed to parse line: %lli\n", linecount);
-    CBF_clean(data, mem);
+  // The last chunk ends where the block ends
+  if (res == CBF_RES_OK) {
+    rd->pos = chunks[numchunks-1].rd.pos;
+    rd->linecount = chunks[numchunks-1].rd.linecount;
   }
 
-  FCLOSE(pFile);
+  free(chunks);
   return res;
 }
 
-static void CBF_clean(CBFdata *data, CBFfrontendmemory *mem) {
-  if (data->mapstacknum >= 1) {
-    free(data->mapstackdim);
-    free(data->mapstackdomain);
-  }
+/*
+ * Sets the first entry, position and line count of each chunk by scanning
+ * the lines of the block. Returns the number of chunks, or 0 if the block
+ * is truncated.
+ */
+static int CBF_splitentries(CBFreader *rd, long long int nnz, CBFchunk *chunks, int numchunks)
+{
+  const char *end = rd->end;
+  const char *p, *eol;
+  long long int i, linecount;
+  int c;
+
+  p = rd->pos;
+  linecount = rd->linecount;
+  for (i=0, c=0; i<nnz && p<end; ) {
+    if (c < numchunks && i == nnz * c / numchunks) {
+      chunks[c].rd.pos = p;
+      chunks[c].rd.linecount = linecount;
+      chunks[c].ibeg = i;
+      ++c;
+    }
 
-  if (data->varstacknum >= 1) {
-    free(data->varstackdim);
-    free(data->varstackdomain);
-  }
+    eol = CBF_lexnewline(p, end);
+    if (!eol)
+      eol = end;
 
-  if (data->intvarnum >= 1) {
-    free(data->intvar);
-  }
+    ++linecount;
+    if (p == eol || *p != '#')
+      ++i;
 
-  if (data->psdmapnum >= 1) {
-    free(data->psdmapdim);
+    p = (eol < end) ? eol + 1 : eol;
   }
 
-  if (data->psdvarnum >= 1) {
-    free(data->psdvardim);
-  }
+  return (i < nnz) ? 0 : numchunks;
+}
 
-  if (data->objfnnz >= 1) {
-    free(data->objfsubj);
-    free(data->objfsubk);
-    free(data->objfsubl);
-    free(data->objfval);
+/*
+ * As CBF_splitentries, but takes the chunks from the entry positions of the
+ * block in the section index. Returns 0 if the index has none to offer.
+ */
+static int CBF_splitentries_index(CBFreader *rd, long long int nnz, CBFchunk *chunks, int numchunks)
+{
+  const CBFsection *marks;
+  long long int s, k, nummarks;
+  int c;
+
+  s = CBF_findsection(rd);
+  if (s < 0)
+    return 0;
+
+  // Positions of entries 1*stride, 2*stride, ... follow the row of the block
+  marks = &rd->sections[s+1];
+  for (nummarks = 0; s+1+nummarks < rd->sectionnum && strcmp(marks[nummarks].keyword, "+") == 0; ++nummarks) {
+    if (marks[nummarks].count <= ((nummarks >= 1) ? marks[nummarks-1].count : 0) || marks[nummarks].count >= nnz)
+      return 0;
+    if (marks[nummarks].offset < rd->pos - rd->map)
+      return 0;
   }
 
-  if (data->objannz >= 1) {
-    free(data->objasubj);
-    free(data->objaval);
-  }
+  if (numchunks > nummarks + 1)
+    numchunks = (int) (nummarks + 1);
 
-  if (data->fnnz >= 1) {
-    free(data->fsubi);
-    free(data->fsubj);
-    free(data->fsubk);
-    free(data->fsubl);
-    free(data->fval);
-  }
+  chunks[0].rd.pos = rd->pos;
+  chunks[0].rd.linecount = rd->linecount;
+  chunks[0].ibeg = 0;
 
-  if (data->annz >= 1) {
-    free(data->asubi);
-    free(data->asubj);
-    free(data->aval);
+  for (c=1; c<numchunks; ++c) {
+    k = (nummarks + 1) * c / numchunks - 1;
+    chunks[c].rd.pos = rd->map + marks[k].offset;
+    chunks[c].rd.linecount = marks[k].line - 1;
+    chunks[c].ibeg = marks[k].count;
   }
 
-  if (data->bnnz >= 1) {
-    free(data->bsubi);
-    free(data->bval);
-  }
+  return (numchunks >= 2) ? numchunks : 0;
+}
 
-  if (data->hnnz >= 1) {
-    free(data->hsubi);
-    free(data->hsubj);
-    free(data->hsubk);
-    free(data->hsubl);
-    free(data->hval);
+static void CBF_readentries_task(void *chunk)
+{
+  CBFchunk *ck = (CBFchunk*) chunk;
+  ck->res = CBF_readentries_serial(&ck->rd, ck->data, ck->ibeg, ck->iend, 0, ck->readentry, ck->checkentries);
+}
+
+/*
+ * The range checks below test a strip of entries at once without branching
+ * (so compilers can vectorize them), and only search the strip for the
+ * first entry out of range when there is one. A single unsigned comparison
+ * rejects negative indices as well. Each check returns the new end of the
+ * range for the next one, so checks of dimensions only see valid cones.
+ */
+static long long int CBF_checkrange(const long long int *sub, long long int ibeg, long long int iend, long long int num)
+{
+  long long int i, j, jend;
+  int bad;
+
+  for (i=ibeg; i<iend; i=jend) {
+    jend = (iend - i > CBF_CHECK_STRIP) ? i + CBF_CHECK_STRIP : iend;
+
+    bad = 0;
+    for (j=i; j<jend; ++j)
+      bad |= ((unsigned long long int) sub[j] >= (unsigned long long int) num);
+
+    if (bad)
+      for (j=i; j<jend; ++j)
+        if ((unsigned long long int) sub[j] >= (unsigned long long int) num)
+          return j;
   }
 
-  if (data->dnnz >= 1) {
-    free(data->dsubi);
-    free(data->dsubk);
-    free(data->dsubl);
-    free(data->dval);
+  return iend;
+}
+
+static long long int CBF_checkrange_int(const int *sub, long long int ibeg, long long int iend, int num)
+{
+  long long int i, j, jend;
+  int bad;
+
+  for (i=ibeg; i<iend; i=jend) {
+    jend = (iend - i > CBF_CHECK_STRIP) ? i + CBF_CHECK_STRIP : iend;
+
+    bad = 0;
+    for (j=i; j<jend; ++j)
+      bad |= ((unsigned int) sub[j] >= (unsigned int) num);
+
+    if (bad)
+      for (j=i; j<jend; ++j)
+        if ((unsigned int) sub[j] >= (unsigned int) num)
+          return j;
   }
+
+  return iend;
 }
 
-static CBFresponsee CBF_fgets(CBFFILE *pFile, long long int *linecount)
+// As CBF_checkrange_int with num = dim[subj[j]], for subj already checked
+static long long int CBF_checkdim(const int *subj, const int *subk, const int *dim, long long int ibeg, long long int iend)
 {
-  // Find first non-commentary line
-  while( FGETS(CBF_LINE_BUFFER, sizeof(CBF_LINE_BUFFER), pFile) != NULL ) {
-    ++(*linecount);
+  long long int i, j, jend;
+  int bad;
 
-    if (CBF_LINE_BUFFER[0] != '#')
-      return CBF_RES_OK;
+  for (i=ibeg; i<iend; i=jend) {
+    jend = (iend - i > CBF_CHECK_STRIP) ? i + CBF_CHECK_STRIP : iend;
+
+    bad = 0;
+    for (j=i; j<jend; ++j)
+      bad |= ((unsigned int) subk[j] >= (unsigned int) dim[subj[j]]);
+
+    if (bad)
+      for (j=i; j<jend; ++j)
+        if ((unsigned int) subk[j] >= (unsigned int) dim[subj[j]])
+          return j;
   }
 
-  return CBF_RES_ERR;
+  return iend;
+}
+
+static int CBF_sscanf(CBFreader *rd, const char *format, ...)
+{
+  va_list args;
+  int count;
+
+  va_start(args, format);
+  count = CBF_vlexscan(rd->line, rd->lineend, format, args);
+  va_end(args);
+
+  return count;
 }
 
-static CBFresponsee readVER(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static CBFresponsee readVER(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%i", &data->ver) != 1)
+    if (CBF_sscanf(rd, "%i", &data->ver) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK) {
     if (data->ver > CBF_VERSION) {
-      printf("The version of the file format is not support.\n");
+      fprintf(CBF_messagestream(), "The version of the file format is not support.\n");
       res = CBF_RES_ERR;
     }
   }
@@ -311,31 +1541,31 @@ static CBFresponsee readVER(CBFFILE *pFile, long long int *linecount, CBFdata *d
   return res;
 }
 
-static CBFresponsee readOBJSENSE(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static CBFresponsee readOBJSENSE(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, CBF_NAME_FORMAT, CBF_NAME_BUFFER) != 1)
+    if (CBF_sscanf(rd, CBF_NAME_FORMAT, rd->namebuf) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
-    res = CBF_strtoobjsense(CBF_NAME_BUFFER, &data->objsense);
+    res = CBF_strtoobjsense(rd->namebuf, &data->objsense);
 
   return res;
 }
 
-static CBFresponsee readCON(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static CBFresponsee readCON(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i, mapnum = 0;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli %lli", &data->mapnum, &data->mapstacknum) != 2)
+    if (CBF_sscanf(rd, "%lli %lli", &data->mapnum, &data->mapstacknum) != 2)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -348,15 +1578,15 @@ static CBFresponsee readCON(CBFFILE *pFile, long long int *linecount, CBFdata *d
   }
 
   for (i=0; i<(data->mapstacknum) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
+    res = CBF_fgets(rd);
 
     if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, CBF_NAME_FORMAT" %lli", CBF_NAME_BUFFER, &data->mapstackdim[i]) != 2)
+      if (CBF_sscanf(rd, CBF_NAME_FORMAT" %lli", rd->namebuf, &data->mapstackdim[i]) != 2)
         res = CBF_RES_ERR;
 
     if (res == CBF_RES_OK) {
       mapnum += data->mapstackdim[i];
-      res = CBF_strtocone(CBF_NAME_BUFFER, &data->mapstackdomain[i]);
+      res = CBF_strtocone(rd->namebuf, &data->mapstackdomain[i]);
     }
 
     if (res == CBF_RES_OK)
@@ -371,15 +1601,15 @@ static CBFresponsee readCON(CBFFILE *pFile, long long int *linecount, CBFdata *d
   return res;
 }
 
-static CBFresponsee readVAR(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static CBFresponsee readVAR(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i, varnum = 0;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli %lli", &data->varnum, &data->varstacknum) != 2)
+    if (CBF_sscanf(rd, "%lli %lli", &data->varnum, &data->varstacknum) != 2)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -392,15 +1622,15 @@ static CBFresponsee readVAR(CBFFILE *pFile, long long int *linecount, CBFdata *d
   }
 
   for (i=0; i<(data->varstacknum) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
+    res = CBF_fgets(rd);
 
     if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, CBF_NAME_FORMAT" %lli", CBF_NAME_BUFFER, &data->varstackdim[i]) != 2)
+      if (CBF_sscanf(rd, CBF_NAME_FORMAT" %lli", rd->namebuf, &data->varstackdim[i]) != 2)
         res = CBF_RES_ERR;
 
     if (res == CBF_RES_OK) {
       varnum += data->varstackdim[i];
-      res = CBF_strtocone(CBF_NAME_BUFFER, &data->varstackdomain[i]);
+      res = CBF_strtocone(rd->namebuf, &data->varstackdomain[i]);
     }
 
     if (res == CBF_RES_OK)
@@ -415,15 +1645,15 @@ static CBFresponsee readVAR(CBFFILE *pFile, long long int *linecount, CBFdata *d
   return res;
 }
 
-static CBFresponsee readINT(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static CBFresponsee readINT(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
   long long int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli", &data->intvarnum) != 1)
+    if (CBF_sscanf(rd, "%lli", &data->intvarnum) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -438,10 +1668,10 @@ static CBFresponsee readINT(CBFFILE *pFile, long long int *linecount, CBFdata *d
   }
 
   for (i=0; i<(data->intvarnum) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
+    res = CBF_fgets(rd);
 
     if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%lli", &data->intvar[i]) != 1)
+      if (CBF_sscanf(rd, "%lli", &data->intvar[i]) != 1)
         res = CBF_RES_ERR;
 
     if (res == CBF_RES_OK)
@@ -449,18 +1679,21 @@ static CBFresponsee readINT(CBFFILE *pFile, long long int *linecount, CBFdata *d
         res = CBF_RES_ERR;
   }
 
+  if (res == CBF_RES_OK)
+    CBF_marksorted(rd, data, CBF_SORTED_INT);
+
   return res;
 }
 
-static CBFresponsee readPSDCON(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static CBFresponsee readPSDCON(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
   int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%i", &data->psdmapnum) != 1)
+    if (CBF_sscanf(rd, "%i", &data->psdmapnum) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -472,10 +1705,10 @@ static CBFresponsee readPSDCON(CBFFILE *pFile, long long int *linecount, CBFdata
   }
 
   for (i=0; i<(data->psdmapnum) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
+    res = CBF_fgets(rd);
 
     if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%i", &data->psdmapdim[i]) != 1)
+      if (CBF_sscanf(rd, "%i", &data->psdmapdim[i]) != 1)
         res = CBF_RES_ERR;
 
     if (res == CBF_RES_OK)
@@ -486,15 +1719,15 @@ static CBFresponsee readPSDCON(CBFFILE *pFile, long long int *linecount, CBFdata
   return res;
 }
 
-static CBFresponsee readPSDVAR(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static CBFresponsee readPSDVAR(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
   int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%i", &data->psdvarnum) != 1)
+    if (CBF_sscanf(rd, "%i", &data->psdvarnum) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -506,10 +1739,10 @@ static CBFresponsee readPSDVAR(CBFFILE *pFile, long long int *linecount, CBFdata
   }
 
   for (i=0; i<(data->psdvarnum) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
+    res = CBF_fgets(rd);
 
     if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%i", &data->psdvardim[i]) != 1)
+      if (CBF_sscanf(rd, "%i", &data->psdvardim[i]) != 1)
         res = CBF_RES_ERR;
 
     if (res == CBF_RES_OK)
@@ -520,15 +1753,14 @@ static CBFresponsee readPSDVAR(CBFFILE *pFile, long long int *linecount, CBFdata
   return res;
 }
 
-static CBFresponsee readOBJFCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static CBFresponsee readOBJFCOORD(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli", &data->objfnnz) != 1)
+    if (CBF_sscanf(rd, "%lli", &data->objfnnz) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -536,44 +1768,45 @@ static CBFresponsee readOBJFCOORD(CBFFILE *pFile, long long int *linecount, CBFd
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK) {
-    data->objfsubj = (int*) calloc(data->objfnnz, sizeof(data->objfsubj[0]));
-    data->objfsubk = (int*) calloc(data->objfnnz, sizeof(data->objfsubk[0]));
-    data->objfsubl = (int*) calloc(data->objfnnz, sizeof(data->objfsubl[0]));
-    data->objfval  = (double*) calloc(data->objfnnz, sizeof(data->objfval[0]));
+    data->objfsubj = (int*) calloc(CBF_capacity(rd, data->objfnnz), sizeof(data->objfsubj[0]));
+    data->objfsubk = (int*) calloc(CBF_capacity(rd, data->objfnnz), sizeof(data->objfsubk[0]));
+    data->objfsubl = (int*) calloc(CBF_capacity(rd, data->objfnnz), sizeof(data->objfsubl[0]));
+    data->objfval  = (double*) calloc(CBF_capacity(rd, data->objfnnz), sizeof(data->objfval[0]));
   }
 
-  for (i=0; i<(data->objfnnz) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
-
-    if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%i %i %i %lg", &data->objfsubj[i], &data->objfsubk[i], &data->objfsubl[i], &data->objfval[i]) != 4)
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    res = CBF_readentries(rd, data, data->objfnnz, readOBJFCOORD_entry, checkOBJFCOORD);
 
-    if (res == CBF_RES_OK)
-      if ( (data->objfsubj[i]) < 0 || (data->psdvarnum-1) < (data->objfsubj[i]) )
-        res = CBF_RES_ERR;
+  return res;
+}
 
-    if (res == CBF_RES_OK)
-      if ( (data->objfsubk[i]) < 0 || (data->psdvardim[data->objfsubj[i]]-1) < (data->objfsubk[i]) )
-        res = CBF_RES_ERR;
+static CBFresponsee readOBJFCOORD_entry(CBFreader *rd, CBFdata *data, long long int i)
+{
+  CBFresponsee res = CBF_RES_OK;
 
-    if (res == CBF_RES_OK)
-      if ( (data->objfsubl[i]) < 0 || (data->psdvardim[data->objfsubj[i]]-1) < (data->objfsubl[i]) )
-        res = CBF_RES_ERR;
-  }
+  if (CBF_sscanf(rd, "%i %i %i %lg", &data->objfsubj[i], &data->objfsubk[i], &data->objfsubl[i], &data->objfval[i]) != 4)
+    res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee readOBJACOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static long long int checkOBJFCOORD(const CBFdata *data, long long int ibeg, long long int iend)
+{
+  iend = CBF_checkrange_int(data->objfsubj, ibeg, iend, data->psdvarnum);
+  iend = CBF_checkdim(data->objfsubj, data->objfsubk, data->psdvardim, ibeg, iend);
+  iend = CBF_checkdim(data->objfsubj, data->objfsubl, data->psdvardim, ibeg, iend);
+
+  return iend;
+}
+
+static CBFresponsee readOBJACOORD(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli", &data->objannz) != 1)
+    if (CBF_sscanf(rd, "%lli", &data->objannz) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -581,47 +1814,57 @@ static CBFresponsee readOBJACOORD(CBFFILE *pFile, long long int *linecount, CBFd
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK) {
-    data->objasubj = (long long int*) calloc(data->objannz, sizeof(data->objasubj[0]));
-    data->objaval  = (double*) calloc(data->objannz, sizeof(data->objaval[0]));
+    data->objasubj = (long long int*) calloc(CBF_capacity(rd, data->objannz), sizeof(data->objasubj[0]));
+    data->objaval  = (double*) calloc(CBF_capacity(rd, data->objannz), sizeof(data->objaval[0]));
   }
 
-  for (i=0; i<(data->objannz) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
+  if (res == CBF_RES_OK)
+    res = CBF_readentries(rd, data, data->objannz, readOBJACOORD_entry, checkOBJACOORD);
 
-    if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%lli %lg", &data->objasubj[i], &data->objaval[i]) != 2)
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    CBF_marksorted(rd, data, CBF_SORTED_OBJA);
 
-    if (res == CBF_RES_OK)
-      if ( (data->objasubj[i]) < 0 || (data->varnum-1) < (data->objasubj[i]) )
-        res = CBF_RES_ERR;
-  }
+  return res;
+}
+
+static CBFresponsee readOBJACOORD_entry(CBFreader *rd, CBFdata *data, long long int i)
+{
+  CBFresponsee res = CBF_RES_OK;
+
+  if (CBF_sscanf(rd, "%lli %lg", &data->objasubj[i], &data->objaval[i]) != 2)
+    res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee readOBJBCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static long long int checkOBJACOORD(const CBFdata *data, long long int ibeg, long long int iend)
+{
+  iend = CBF_checkrange(data->objasubj, ibeg, iend, data->varnum);
+
+  return iend;
+}
+
+static CBFresponsee readOBJBCOORD(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lg", &data->objbval) != 1)
+    if (CBF_sscanf(rd, "%lg", &data->objbval) != 1)
       res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee readFCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static CBFresponsee readFCOORD(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli", &data->fnnz) != 1)
+    if (CBF_sscanf(rd, "%lli", &data->fnnz) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -629,49 +1872,50 @@ static CBFresponsee readFCOORD(CBFFILE *pFile, long long int *linecount, CBFdata
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK) {
-    data->fsubi = (long long int*) calloc(data->fnnz, sizeof(data->fsubi[0]));
-    data->fsubj = (int*) calloc(data->fnnz, sizeof(data->fsubj[0]));
-    data->fsubk = (int*) calloc(data->fnnz, sizeof(data->fsubk[0]));
-    data->fsubl = (int*) calloc(data->fnnz, sizeof(data->fsubl[0]));
-    data->fval  = (double*) calloc(data->fnnz, sizeof(data->fval[0]));
+    data->fsubi = (long long int*) calloc(CBF_capacity(rd, data->fnnz), sizeof(data->fsubi[0]));
+    data->fsubj = (int*) calloc(CBF_capacity(rd, data->fnnz), sizeof(data->fsubj[0]));
+    data->fsubk = (int*) calloc(CBF_capacity(rd, data->fnnz), sizeof(data->fsubk[0]));
+    data->fsubl = (int*) calloc(CBF_capacity(rd, data->fnnz), sizeof(data->fsubl[0]));
+    data->fval  = (double*) calloc(CBF_capacity(rd, data->fnnz), sizeof(data->fval[0]));
   }
 
-  for (i=0; i<(data->fnnz) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
-
-    if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%lli %i %i %i %lg", &data->fsubi[i], &data->fsubj[i], &data->fsubk[i], &data->fsubl[i], &data->fval[i]) != 5)
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    res = CBF_readentries(rd, data, data->fnnz, readFCOORD_entry, checkFCOORD);
 
-    if (res == CBF_RES_OK)
-      if ( (data->fsubi[i]) < 0 || (data->mapnum-1) < (data->fsubi[i]) )
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    CBF_marksorted(rd, data, CBF_SORTED_F);
 
-    if (res == CBF_RES_OK)
-      if ( (data->fsubj[i]) < 0 || (data->psdvarnum-1) < (data->fsubj[i]) )
-        res = CBF_RES_ERR;
+  return res;
+}
 
-    if (res == CBF_RES_OK)
-      if ( (data->fsubk[i]) < 0 || (data->psdvardim[data->fsubj[i]]-1) < (data->fsubk[i]) )
-        res = CBF_RES_ERR;
+static CBFresponsee readFCOORD_entry(CBFreader *rd, CBFdata *data, long long int i)
+{
+  CBFresponsee res = CBF_RES_OK;
 
-    if (res == CBF_RES_OK)
-      if ( (data->fsubl[i]) < 0 || (data->psdvardim[data->fsubj[i]]-1) < (data->fsubl[i]) )
-        res = CBF_RES_ERR;
-  }
+  if (CBF_sscanf(rd, "%lli %i %i %i %lg", &data->fsubi[i], &data->fsubj[i], &data->fsubk[i], &data->fsubl[i], &data->fval[i]) != 5)
+    res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee readACOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static long long int checkFCOORD(const CBFdata *data, long long int ibeg, long long int iend)
+{
+  iend = CBF_checkrange(data->fsubi, ibeg, iend, data->mapnum);
+  iend = CBF_checkrange_int(data->fsubj, ibeg, iend, data->psdvarnum);
+  iend = CBF_checkdim(data->fsubj, data->fsubk, data->psdvardim, ibeg, iend);
+  iend = CBF_checkdim(data->fsubj, data->fsubl, data->psdvardim, ibeg, iend);
+
+  return iend;
+}
+
+static CBFresponsee readACOORD(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli", &data->annz) != 1)
+    if (CBF_sscanf(rd, "%lli", &data->annz) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -679,39 +1923,46 @@ static CBFresponsee readACOORD(CBFFILE *pFile, long long int *linecount, CBFdata
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK) {
-    data->asubi = (long long int*) calloc(data->annz, sizeof(data->asubi[0]));
-    data->asubj = (long long int*) calloc(data->annz, sizeof(data->asubj[0]));
-    data->aval  = (double*) calloc(data->annz, sizeof(data->aval[0]));
+    data->asubi = (long long int*) calloc(CBF_capacity(rd, data->annz), sizeof(data->asubi[0]));
+    data->asubj = (long long int*) calloc(CBF_capacity(rd, data->annz), sizeof(data->asubj[0]));
+    data->aval  = (double*) calloc(CBF_capacity(rd, data->annz), sizeof(data->aval[0]));
   }
 
-  for (i=0; i<(data->annz) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
+  if (res == CBF_RES_OK)
+    res = CBF_readentries(rd, data, data->annz, readACOORD_entry, checkACOORD);
 
-    if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%lli %lli %lg", &data->asubi[i], &data->asubj[i], &data->aval[i]) != 3)
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    CBF_marksorted(rd, data, CBF_SORTED_A | CBF_SORTED_ACOL);
 
-    if (res == CBF_RES_OK)
-      if ( (data->asubi[i]) < 0 || (data->mapnum-1) < (data->asubi[i]) )
-        res = CBF_RES_ERR;
+  return res;
+}
 
-    if (res == CBF_RES_OK)
-      if ( (data->asubj[i]) < 0 || (data->varnum-1) < (data->asubj[i]) )
-        res = CBF_RES_ERR;
-  }
+static CBFresponsee readACOORD_entry(CBFreader *rd, CBFdata *data, long long int i)
+{
+  CBFresponsee res = CBF_RES_OK;
+
+  if (CBF_sscanf(rd, "%lli %lli %lg", &data->asubi[i], &data->asubj[i], &data->aval[i]) != 3)
+    res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee readBCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static long long int checkACOORD(const CBFdata *data, long long int ibeg, long long int iend)
+{
+  iend = CBF_checkrange(data->asubi, ibeg, iend, data->mapnum);
+  iend = CBF_checkrange(data->asubj, ibeg, iend, data->varnum);
+
+  return iend;
+}
+
+static CBFresponsee readBCOORD(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli", &data->bnnz) != 1)
+    if (CBF_sscanf(rd, "%lli", &data->bnnz) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -719,34 +1970,44 @@ static CBFresponsee readBCOORD(CBFFILE *pFile, long long int *linecount, CBFdata
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK) {
-    data->bsubi = (long long int*) calloc(data->bnnz, sizeof(data->bsubi[0]));
-    data->bval  = (double*) calloc(data->bnnz, sizeof(data->bval[0]));
+    data->bsubi = (long long int*) calloc(CBF_capacity(rd, data->bnnz), sizeof(data->bsubi[0]));
+    data->bval  = (double*) calloc(CBF_capacity(rd, data->bnnz), sizeof(data->bval[0]));
   }
 
-  for (i=0; i<(data->bnnz) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
+  if (res == CBF_RES_OK)
+    res = CBF_readentries(rd, data, data->bnnz, readBCOORD_entry, checkBCOORD);
 
-    if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%lli %lg", &data->bsubi[i], &data->bval[i]) != 2)
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    CBF_marksorted(rd, data, CBF_SORTED_B);
 
-    if (res == CBF_RES_OK)
-      if ( (data->bsubi[i]) < 0 || (data->mapnum-1) < (data->bsubi[i]) )
-        res = CBF_RES_ERR;
-  }
+  return res;
+}
+
+static CBFresponsee readBCOORD_entry(CBFreader *rd, CBFdata *data, long long int i)
+{
+  CBFresponsee res = CBF_RES_OK;
+
+  if (CBF_sscanf(rd, "%lli %lg", &data->bsubi[i], &data->bval[i]) != 2)
+    res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee readHCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static long long int checkBCOORD(const CBFdata *data, long long int ibeg, long long int iend)
+{
+  iend = CBF_checkrange(data->bsubi, ibeg, iend, data->mapnum);
+
+  return iend;
+}
+
+static CBFresponsee readHCOORD(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli", &data->hnnz) != 1)
+    if (CBF_sscanf(rd, "%lli", &data->hnnz) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -754,49 +2015,50 @@ static CBFresponsee readHCOORD(CBFFILE *pFile, long long int *linecount, CBFdata
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK) {
-    data->hsubi = (int*) calloc(data->hnnz, sizeof(data->hsubi[0]));
-    data->hsubj = (long long int*) calloc(data->hnnz, sizeof(data->hsubj[0]));
-    data->hsubk = (int*) calloc(data->hnnz, sizeof(data->hsubk[0]));
-    data->hsubl = (int*) calloc(data->hnnz, sizeof(data->hsubl[0]));
-    data->hval  = (double*) calloc(data->hnnz, sizeof(data->hval[0]));
+    data->hsubi = (int*) calloc(CBF_capacity(rd, data->hnnz), sizeof(data->hsubi[0]));
+    data->hsubj = (long long int*) calloc(CBF_capacity(rd, data->hnnz), sizeof(data->hsubj[0]));
+    data->hsubk = (int*) calloc(CBF_capacity(rd, data->hnnz), sizeof(data->hsubk[0]));
+    data->hsubl = (int*) calloc(CBF_capacity(rd, data->hnnz), sizeof(data->hsubl[0]));
+    data->hval  = (double*) calloc(CBF_capacity(rd, data->hnnz), sizeof(data->hval[0]));
   }
 
-  for (i=0; i<(data->hnnz) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
-
-    if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%i %lli %i %i %lg", &data->hsubi[i], &data->hsubj[i], &data->hsubk[i], &data->hsubl[i], &data->hval[i]) != 5)
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    res = CBF_readentries(rd, data, data->hnnz, readHCOORD_entry, checkHCOORD);
 
-    if (res == CBF_RES_OK)
-      if ( (data->hsubi[i]) < 0 || (data->psdmapnum-1) < (data->hsubi[i]) )
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    CBF_marksorted(rd, data, CBF_SORTED_H);
 
-    if (res == CBF_RES_OK)
-      if ( (data->hsubj[i]) < 0 || (data->varnum-1) < (data->hsubj[i]) )
-        res = CBF_RES_ERR;
+  return res;
+}
 
-    if (res == CBF_RES_OK)
-      if ( (data->hsubk[i]) < 0 || (data->psdmapdim[data->hsubi[i]]-1) < (data->hsubk[i]) )
-        res = CBF_RES_ERR;
+static CBFresponsee readHCOORD_entry(CBFreader *rd, CBFdata *data, long long int i)
+{
+  CBFresponsee res = CBF_RES_OK;
 
-    if (res == CBF_RES_OK)
-      if ( (data->hsubl[i]) < 0 || (data->psdmapdim[data->hsubi[i]]-1) < (data->hsubl[i]) )
-        res = CBF_RES_ERR;
-  }
+  if (CBF_sscanf(rd, "%i %lli %i %i %lg", &data->hsubi[i], &data->hsubj[i], &data->hsubk[i], &data->hsubl[i], &data->hval[i]) != 5)
+    res = CBF_RES_ERR;
 
   return res;
 }
 
-static CBFresponsee readDCOORD(CBFFILE *pFile, long long int *linecount, CBFdata *data)
+static long long int checkHCOORD(const CBFdata *data, long long int ibeg, long long int iend)
+{
+  iend = CBF_checkrange_int(data->hsubi, ibeg, iend, data->psdmapnum);
+  iend = CBF_checkrange(data->hsubj, ibeg, iend, data->varnum);
+  iend = CBF_checkdim(data->hsubi, data->hsubk, data->psdmapdim, ibeg, iend);
+  iend = CBF_checkdim(data->hsubi, data->hsubl, data->psdmapdim, ibeg, iend);
+
+  return iend;
+}
+
+static CBFresponsee readDCOORD(CBFreader *rd, CBFdata *data)
 {
   CBFresponsee res = CBF_RES_OK;
-  long long int i;
 
-  res = CBF_fgets(pFile, linecount);
+  res = CBF_fgets(rd);
 
   if (res == CBF_RES_OK)
-    if (sscanf(CBF_LINE_BUFFER, "%lli", &data->dnnz) != 1)
+    if (CBF_sscanf(rd, "%lli", &data->dnnz) != 1)
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK)
@@ -804,32 +2066,37 @@ static CBFresponsee readDCOORD(CBFFILE *pFile, long long int *linecount, CBFdata
       res = CBF_RES_ERR;
 
   if (res == CBF_RES_OK) {
-    data->dsubi = (int*) calloc(data->dnnz, sizeof(data->dsubi[0]));
-    data->dsubk = (int*) calloc(data->dnnz, sizeof(data->dsubk[0]));
-    data->dsubl = (int*) calloc(data->dnnz, sizeof(data->dsubl[0]));
-    data->dval  = (double*) calloc(data->dnnz, sizeof(data->dval[0]));
+    data->dsubi = (int*) calloc(CBF_capacity(rd, data->dnnz), sizeof(data->dsubi[0]));
+    data->dsubk = (int*) calloc(CBF_capacity(rd, data->dnnz), sizeof(data->dsubk[0]));
+    data->dsubl = (int*) calloc(CBF_capacity(rd, data->dnnz), sizeof(data->dsubl[0]));
+    data->dval  = (double*) calloc(CBF_capacity(rd, data->dnnz), sizeof(data->dval[0]));
   }
 
-  for (i=0; i<(data->dnnz) && res==CBF_RES_OK; ++i) {
-    res = CBF_fgets(pFile, linecount);
+  if (res == CBF_RES_OK)
+    res = CBF_readentries(rd, data, data->dnnz, readDCOORD_entry, checkDCOORD);
 
-    if (res == CBF_RES_OK)
-      if (sscanf(CBF_LINE_BUFFER, "%i %i %i %lg", &data->dsubi[i], &data->dsubk[i], &data->dsubl[i], &data->dval[i]) != 4)
-        res = CBF_RES_ERR;
+  if (res == CBF_RES_OK)
+    CBF_marksorted(rd, data, CBF_SORTED_D);
 
-    if (res == CBF_RES_OK)
-      if ( (data->dsubi[i]) < 0 || (data->psdmapnum-1) < (data->dsubi[i]) )
-        res = CBF_RES_ERR;
+  return res;
+}
 
-    if (res == CBF_RES_OK)
-      if ( (data->dsubk[i]) < 0 || (data->psdmapdim[data->dsubi[i]]-1) < (data->dsubk[i]) )
-        res = CBF_RES_ERR;
+static CBFresponsee readDCOORD_entry(CBFreader *rd, CBFdata *data, long long int i)
+{
+  CBFresponsee res = CBF_RES_OK;
 
-    if (res == CBF_RES_OK)
-      if ( (data->dsubl[i]) < 0 || (data->psdmapdim[data->dsubi[i]]-1) < (data->dsubl[i]) )
-        res = CBF_RES_ERR;
-  }
+  if (CBF_sscanf(rd, "%i %i %i %lg", &data->dsubi[i], &data->dsubk[i], &data->dsubl[i], &data->dval[i]) != 4)
+    res = CBF_RES_ERR;
 
   return res;
 }
 
+static long long int checkDCOORD(const CBFdata *data, long long int ibeg, long long int iend)
+{
+  iend = CBF_checkrange_int(data->dsubi, ibeg, iend, data->psdmapnum);
+  iend = CBF_checkdim(data->dsubi, data->dsubk, data->psdmapdim, ibeg, iend);
+  iend = CBF_checkdim(data->dsubi, data->dsubl, data->psdmapdim, ibeg, iend);
+
+  return iend;
+}
+
@@ -21,7 +21,94 @@
 
 #include "frontend.h"
 
+// Reentrant: all parser state is local to a call of read, so several
+// threads may read distinct files (into distinct CBFdata) concurrently.
 extern CBFfrontend const frontend_cbf;
+extern CBFfrontend const frontend_cbf_mmap;
+
+// Checks that the indices of all coordinates in data are in range, as done
+// while reading them, for frontends that obtain coordinates in other ways.
+CBFresponsee
+  CBF_checkcoordinates(const CBFdata *data);
+
+// Header-only reading for fast queries of problem sizes. The information
+// blocks (VER, OBJSENSE, CON, VAR, INT, PSDCON, PSDVAR and OBJBCOORD) are
+// read as usual, while of the coordinate blocks only the number of entries
+// is read and their lines are skipped unparsed. The coordinate arrays hold
+// no entries, so the data can not be passed on to a backend.
+extern CBFfrontend const frontend_cbf_header;
+
+/*
+ * Section index of a CBF file, written by backend_cbf_index to the file name
+ * followed by CBF_SECTION_EXTENSION. Each line "KEYWORD OFFSET LINE COUNT"
+ * locates a block by the byte offset and line number of its keyword, and
+ * COUNT is its number of entries (cones, integers or coordinates). Large
+ * coordinate blocks are followed by lines "+ OFFSET LINE ENTRY" locating
+ * every 65536th entry, and the last line "END SIZE LINES 0" ends the file.
+ *
+ * frontend_cbf_mmap uses the index, if present and matching the file, to
+ * split large coordinate blocks over threads without scanning them first.
+ *
+ * CBF_readsection reads the information blocks and the coordinate block of
+ * keyword (e.g. "BCOORD") from an uncompressed CBF file with an index,
+ * seeking past all other blocks. Release data with frontend_cbf.clean(data,
+ * NULL) when done.
+ */
+CBFresponsee
+  CBF_readsection(const char *file, const char *keyword, CBFdata *data);
+
+/*
+ * Event driven reading of a CBF file in constant memory (besides the arrays
+ * of the information blocks). Either callback may be NULL, and returning
+ * CBF_RES_ERR from a callback stops the reading.
+ *
+ * block is called after each information block (VER, OBJSENSE, CON, VAR,
+ * INT, PSDCON, PSDVAR and OBJBCOORD) with everything read so far.
+ *
+ * coordinates is called for consecutive batches of each coordinate block
+ * (OBJFCOORD, OBJACOORD, FCOORD, ACOORD, BCOORD, HCOORD and DCOORD). Entry
+ * first+n of the block is found at index n < count of its arrays in data,
+ * while the nnz field of the block holds the size of the whole block.
+ */
+typedef struct CBFcallbacks_struct {
+
+  void *handle;
+
+  // Largest number of coordinates per batch (0 for the default)
+  long long int batchsize;
+
+  CBFresponsee (*block)(void *handle, const char *keyword, const CBFdata *data);
+  CBFresponsee (*coordinates)(void *handle, const char *keyword, const CBFdata *data, long long int first, long long int count);
+
+  // Skips the checks that indices of coordinates are in range (0 by default)
+  int trustinput;
+
+} CBFcallbacks;
+
+CBFresponsee
+  CBF_readstream(const char *file, const CBFcallbacks *callbacks);
+
+/*
+ * Iteration over the problems of a CBF file with CHANGE blocks. The first
+ * call of CBF_nextproblem reads the base problem into data, and each further
+ * call applies the next CHANGE block to data in place: its coordinates are
+ * appended to those of the previous problem (as in scripts/data/CBFdata.py),
+ * and OBJBCOORD replaces the objective constant. *found is set to 0 when all
+ * problems have been read. If the base problem fails to parse, data is
+ * released by the reader, while a failing CHANGE block leaves data at the
+ * previous problem. Otherwise release data with frontend_cbf.clean(data,
+ * NULL) when done. With trustinput, indices of coordinates are not checked.
+ */
+typedef struct CBFproblemreader_struct CBFproblemreader;
+
+CBFproblemreader *
+  CBF_openproblems(const char *file, int trustinput);
+
+CBFresponsee
+  CBF_nextproblem(CBFproblemreader *pr, CBFdata *data, int *found);
+
+void
+  CBF_closeproblems(CBFproblemreader *pr);
 
 #endif
 
@@ -0,0 +1,414 @@
+// Copyright (c) 2012 by Zuse-Institute Berlin and the Technical University of Denmark.
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+#include "frontend-cbfb.h"
+#include "frontend-cbf.h"
+#include "cbf-binary.h"
+#include "cbf-format.h"
+#include "cbf-stream.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+typedef struct CBFbinarymap_struct {
+  char  *map;
+  size_t mapsize;
+  int    onheap;        // Loaded into memory instead of mapped
+} CBFbinarymap;
+
+static CBFresponsee
+  read(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
+
+static CBFresponsee
+  readbuffer(const char *buf, size_t len, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
+
+static CBFresponsee
+  readmap(CBFresponsee res, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
+
+static void
+  clean(CBFdata *data, CBFfrontendmemory *mem);
+
+static CBFresponsee
+  mapfile(const char *file, CBFbinarymap *bm);
+
+static CBFresponsee
+  loadfile(const char *file, CBFbinarymap *bm);
+
+static CBFresponsee
+  readheader(const CBFbinarymap *bm, CBFdata *data);
+
+static CBFresponsee
+  checkstructure(const CBFdata *data);
+
+static CBFresponsee
+  checkstack(long long int num, long long int stacknum, const long long int *stackdim, const CBFscalarconee *stackdomain);
+
+static void *
+  mapcolumn(const CBFbinarymap *bm, CBFbinarycolumne k, long long int count, size_t size, CBFresponsee *res);
+
+
+// -------------------------------------
+// Global variable
+// -------------------------------------
+
+CBFfrontend const frontend_cbfb = { "cbfb", read, clean, readbuffer };
+
+
+// -------------------------------------
+// Function definitions
+// -------------------------------------
+
+static CBFresponsee read(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput) {
+  CBFresponsee res = CBF_RES_OK;
+  CBFbinarymap *bm = NULL;
+
+  // Use CBFfrontendmemory to remember the mapping
+  *mem = calloc(1, sizeof(*bm));
+  if (!*mem) {
+    return CBF_RES_ERR;
+  }
+  bm = (CBFbinarymap*)*mem;
+
+  // Compressed containers and standard input can not be mapped
+  if (CBF_streamcompression(file) || CBF_isstdstream(file))
+    res = loadfile(file, bm);
+  else
+    res = mapfile(file, bm);
+
+  return readmap(res, data, mem, trustinput);
+}
+
+static CBFresponsee readbuffer(const char *buf, size_t len, CBFdata *data, CBFfrontendmemory *mem, int trustinput) {
+  CBFresponsee res = CBF_RES_OK;
+  CBFbinarymap *bm = NULL;
+
+  *mem = calloc(1, sizeof(*bm));
+  if (!*mem) {
+    return CBF_RES_ERR;
+  }
+  bm = (CBFbinarymap*)*mem;
+
+  // Copied, as transforms modify the arrays in place
+  bm->onheap = 1;
+  bm->map = (char*) malloc(len >= 1 ? len : 1);
+  if (bm->map) {
+    memcpy(bm->map, buf, len);
+    bm->mapsize = len;
+  } else {
+    res = CBF_RES_ERR;
+  }
+
+  return readmap(res, data, mem, trustinput);
+}
+
+// Points data into the container held by mem, once loaded with result res
+static CBFresponsee readmap(CBFresponsee res, CBFdata *data, CBFfrontendmemory *mem, int trustinput) {
+  CBFbinarymap *bm = (CBFbinarymap*)*mem;
+  long long int *intvar;
+
+  if (res != CBF_RES_OK || bm->mapsize < sizeof(CBFbinaryheader)) {
+    clean(data, mem);
+    return CBF_RES_ERR;
+  }
+
+  res = readheader(bm, data);
+
+  if (res == CBF_RES_OK) {
+    data->mapstackdim    = (long long int*)  mapcolumn(bm, CBF_COL_MAPSTACKDIM,    data->mapstacknum, sizeof(data->mapstackdim[0]),    &res);
+    data->mapstackdomain = (CBFscalarconee*) mapcolumn(bm, CBF_COL_MAPSTACKDOMAIN, data->mapstacknum, sizeof(data->mapstackdomain[0]), &res);
+    data->varstackdim    = (long long int*)  mapcolumn(bm, CBF_COL_VARSTACKDIM,    data->varstacknum, sizeof(data->varstackdim[0]),    &res);
+    data->varstackdomain = (CBFscalarconee*) mapcolumn(bm, CBF_COL_VARSTACKDOMAIN, data->varstacknum, sizeof(data->varstackdomain[0]), &res);
+    data->psdmapdim      = (int*)            mapcolumn(bm, CBF_COL_PSDMAPDIM,      data->psdmapnum,   sizeof(data->psdmapdim[0]),      &res);
+    data->psdvardim      = (int*)            mapcolumn(bm, CBF_COL_PSDVARDIM,      data->psdvarnum,   sizeof(data->psdvardim[0]),      &res);
+
+    data->objfsubj = (int*)    mapcolumn(bm, CBF_COL_OBJFSUBJ, data->objfnnz, sizeof(data->objfsubj[0]), &res);
+    data->objfsubk = (int*)    mapcolumn(bm, CBF_COL_OBJFSUBK, data->objfnnz, sizeof(data->objfsubk[0]), &res);
+    data->objfsubl = (int*)    mapcolumn(bm, CBF_COL_OBJFSUBL, data->objfnnz, sizeof(data->objfsubl[0]), &res);
+    data->objfval  = (double*) mapcolumn(bm, CBF_COL_OBJFVAL,  data->objfnnz, sizeof(data->objfval[0]),  &res);
+
+    data->objasubj = (long long int*) mapcolumn(bm, CBF_COL_OBJASUBJ, data->objannz, sizeof(data->objasubj[0]), &res);
+    data->objaval  = (double*)        mapcolumn(bm, CBF_COL_OBJAVAL,  data->objannz, sizeof(data->objaval[0]),  &res);
+
+    data->fsubi = (long long int*) mapcolumn(bm, CBF_COL_FSUBI, data->fnnz, sizeof(data->fsubi[0]), &res);
+    data->fsubj = (int*)           mapcolumn(bm, CBF_COL_FSUBJ, data->fnnz, sizeof(data->fsubj[0]), &res);
+    data->fsubk = (int*)           mapcolumn(bm, CBF_COL_FSUBK, data->fnnz, sizeof(data->fsubk[0]), &res);
+    data->fsubl = (int*)           mapcolumn(bm, CBF_COL_FSUBL, data->fnnz, sizeof(data->fsubl[0]), &res);
+    data->fval  = (double*)        mapcolumn(bm, CBF_COL_FVAL,  data->fnnz, sizeof(data->fval[0]),  &res);
+
+    data->asubi = (long long int*) mapcolumn(bm, CBF_COL_ASUBI, data->annz, sizeof(data->asubi[0]), &res);
+    data->asubj = (long long int*) mapcolumn(bm, CBF_COL_ASUBJ, data->annz, sizeof(data->asubj[0]), &res);
+    data->aval  = (double*)        mapcolumn(bm, CBF_COL_AVAL,  data->annz, sizeof(data->aval[0]),  &res);
+
+    data->bsubi = (long long int*) mapcolumn(bm, CBF_COL_BSUBI, data->bnnz, sizeof(data->bsubi[0]), &res);
+    data->bval  = (double*)        mapcolumn(bm, CBF_COL_BVAL,  data->bnnz, sizeof(data->bval[0]),  &res);
+
+    data->hsubi = (int*)           mapcolumn(bm, CBF_COL_HSUBI, data->hnnz, sizeof(data->hsubi[0]), &res);
+    data->hsubj = (long long int*) mapcolumn(bm, CBF_COL_HSUBJ, data->hnnz, sizeof(data->hsubj[0]), &res);
+    data->hsubk = (int*)           mapcolumn(bm, CBF_COL_HSUBK, data->hnnz, sizeof(data->hsubk[0]), &res);
+    data->hsubl = (int*)           mapcolumn(bm, CBF_COL_HSUBL, data->hnnz, sizeof(data->hsubl[0]), &res);
+    data->hval  = (double*)        mapcolumn(bm, CBF_COL_HVAL,  data->hnnz, sizeof(data->hval[0]),  &res);
+
+    data->dsubi = (int*)    mapcolumn(bm, CBF_COL_DSUBI, data->dnnz, sizeof(data->dsubi[0]), &res);
+    data->dsubk = (int*)    mapcolumn(bm, CBF_COL_DSUBK, data->dnnz, sizeof(data->dsubk[0]), &res);
+    data->dsubl = (int*)    mapcolumn(bm, CBF_COL_DSUBL, data->dnnz, sizeof(data->dsubl[0]), &res);
+    data->dval  = (double*) mapcolumn(bm, CBF_COL_DVAL,  data->dnnz, sizeof(data->dval[0]),  &res);
+  }
+
+  // The integer variables are copied to the heap, as transforms may free them
+  if (res == CBF_RES_OK) {
+    intvar = (long long int*) mapcolumn(bm, CBF_COL_INTVAR, data->intvarnum, sizeof(data->intvar[0]), &res);
+
+    if (res == CBF_RES_OK && data->intvarnum >= 1) {
+      data->intvar = (long long int*) malloc(data->intvarnum * sizeof(data->intvar[0]));
+      if (data->intvar)
+        memcpy(data->intvar, intvar, data->intvarnum * sizeof(data->intvar[0]));
+      else
+        res = CBF_RES_ERR;
+    }
+  }
+
+  // The columns are checked like the text of a CBF file would be
+  if (res == CBF_RES_OK)
+    res = checkstructure(data);
+
+  if (res == CBF_RES_OK && !trustinput)
+    res = CBF_checkcoordinates(data);
+
+  // The container keeps no record of order, so it is found once here
+  if (res == CBF_RES_OK)
+    data->sorted = CBF_findsorted(data, CBF_SORTED_ALL);
+
+  if (res != CBF_RES_OK) {
+    fprintf(CBF_messagestream(), "File is not a valid binary CBF container.\n");
+    if (!data->intvar)
+      data->intvarnum = 0;
+    clean(data, mem);
+  }
+
+  return res;
+}
+
+static void clean(CBFdata *data, CBFfrontendmemory *mem) {
+  CBFbinarymap *bm = (CBFbinarymap*)*mem;
+
+  if (data->intvarnum >= 1) {
+    free(data->intvar);
+  }
+
+  if (bm) {
+    if (bm->onheap)
+      free(bm->map);
+    else if (bm->map)
+      munmap(bm->map, bm->mapsize);
+    free(bm);
+    *mem = NULL;
+  }
+
+  memset(data, 0, sizeof(*data));
+}
+
+static CBFresponsee mapfile(const char *file, CBFbinarymap *bm)
+{
+  struct stat st;
+  void *map;
+  int fd;
+
+  fd = open(file, O_RDONLY);
+  if (fd == -1) {
+    return CBF_RES_ERR;
+  }
+
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CBFbinaryheader)) {
+    close(fd);
+    return CBF_RES_ERR;
+  }
+
+  // Private writable mapping, as transforms modify the arrays in place
+  map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return CBF_RES_ERR;
+  }
+
+  bm->map = (char*) map;
+  bm->mapsize = st.st_size;
+  return CBF_RES_OK;
+}
+
+static CBFresponsee loadfile(const char *file, CBFbinarymap *bm)
+{
+  CBFresponsee res = CBF_RES_OK;
+  CBFstream *pFile;
+  size_t capacity = 1 << 20;
+  long long int len;
+  char *map;
+
+  pFile = CBF_openstream(file, "r");
+  if (!pFile) {
+    return CBF_RES_ERR;
+  }
+
+  bm->onheap = 1;
+  bm->map = (char*) malloc(capacity);
+
+  while (bm->map && res == CBF_RES_OK) {
+    len = CBF_streamread(pFile, bm->map + bm->mapsize, capacity - bm->mapsize);
+    if (len <= 0) {
+      res = (len == 0) ? CBF_RES_OK : CBF_RES_ERR;
+      break;
+    }
+
+    bm->mapsize += len;
+    if (bm->mapsize == capacity) {
+      capacity *= 2;
+      map = (char*) realloc(bm->map, capacity);
+      if (!map)
+        res = CBF_RES_ERR;
+      else
+        bm->map = map;
+    }
+  }
+
+  if (!bm->map)
+    res = CBF_RES_ERR;
+
+  CBF_closestream(pFile);
+  return res;
+}
+
+static CBFresponsee readheader(const CBFbinarymap *bm, CBFdata *data)
+{
+  CBFbinaryheader header;
+
+  memcpy(&header, bm->map, sizeof(header));
+
+  if (memcmp(header.magic, CBF_BINARY_MAGIC, sizeof(header.magic)) != 0)
+    return CBF_RES_ERR;
+
+  if (header.byteorder != CBF_BINARY_BYTEORDER || header.layout != CBF_BINARY_LAYOUT)
+    return CBF_RES_ERR;
+
+  // Versions newer than this reader are rejected, as by the text reader
+  if (header.ver < 1 || header.ver > CBF_VERSION)
+    return CBF_RES_ERR;
+
+  if (header.objsense < CBF_OBJ_BEGIN || header.objsense >= CBF_OBJ_END)
+    return CBF_RES_ERR;
+
+  if (header.mapstacknum < 0 || header.varstacknum < 0 || header.intvarnum < 0 ||
+      header.psdmapnum < 0 || header.psdvarnum < 0 ||
+      header.objfnnz < 0 || header.objannz < 0 || header.fnnz < 0 ||
+      header.annz < 0 || header.bnnz < 0 || header.hnnz < 0 || header.dnnz < 0)
+    return CBF_RES_ERR;
+
+  data->ver         = header.ver;
+  data->objsense    = (CBFobjsensee) header.objsense;
+  data->mapnum      = header.mapnum;
+  data->mapstacknum = header.mapstacknum;
+  data->varnum      = header.varnum;
+  data->varstacknum = header.varstacknum;
+  data->intvarnum   = header.intvarnum;
+  data->psdmapnum   = header.psdmapnum;
+  data->psdvarnum   = header.psdvarnum;
+  data->objfnnz     = header.objfnnz;
+  data->objannz     = header.objannz;
+  data->objbval     = header.objbval;
+  data->fnnz        = header.fnnz;
+  data->annz        = header.annz;
+  data->bnnz        = header.bnnz;
+  data->hnnz        = header.hnnz;
+  data->dnnz        = header.dnnz;
+
+  return CBF_RES_OK;
+}
+
+static CBFresponsee checkstructure(const CBFdata *data)
+{
+  CBFresponsee res = CBF_RES_OK;
+  long long int i;
+
+  if (data->mapnum < 0 || data->varnum < 0)
+    res = CBF_RES_ERR;
+
+  if (res == CBF_RES_OK)
+    res = checkstack(data->mapnum, data->mapstacknum, data->mapstackdim, data->mapstackdomain);
+
+  if (res == CBF_RES_OK)
+    res = checkstack(data->varnum, data->varstacknum, data->varstackdim, data->varstackdomain);
+
+  for (i=0; i<data->psdmapnum && res==CBF_RES_OK; ++i)
+    if (data->psdmapdim[i] < 1)
+      res = CBF_RES_ERR;
+
+  for (i=0; i<data->psdvarnum && res==CBF_RES_OK; ++i)
+    if (data->psdvardim[i] < 1)
+      res = CBF_RES_ERR;
+
+  for (i=0; i<data->intvarnum && res==CBF_RES_OK; ++i)
+    if (data->intvar[i] < 0 || data->intvar[i] >= data->varnum)
+      res = CBF_RES_ERR;
+
+  return res;
+}
+
+// Cones must be known, and their dimensions must add up to num
+static CBFresponsee checkstack(long long int num, long long int stacknum, const long long int *stackdim, const CBFscalarconee *stackdomain)
+{
+  long long int i, sum = 0;
+  int domain;
+
+  for (i=0; i<stacknum; ++i) {
+    // Read as int, as the column may hold values outside of the enum
+    memcpy(&domain, &stackdomain[i], sizeof(domain));
+
+    if (domain < CBF_CONE_BEGIN || domain >= CBF_CONE_END)
+      return CBF_RES_ERR;
+
+    if (stackdim[i] < 0 || stackdim[i] > num - sum)
+      return CBF_RES_ERR;
+
+    sum += stackdim[i];
+  }
+
+  return (sum == num) ? CBF_RES_OK : CBF_RES_ERR;
+}
+
+static void *mapcolumn(const CBFbinarymap *bm, CBFbinarycolumne k, long long int count, size_t size, CBFresponsee *res)
+{
+  long long int offset;
+
+  if (*res != CBF_RES_OK || count == 0)
+    return NULL;
+
+  memcpy(&offset, bm->map + offsetof(CBFbinaryheader, offset) + k*sizeof(offset), sizeof(offset));
+
+  // Columns must be aligned and lie within the file
+  if (offset < (long long int)sizeof(CBFbinaryheader) || offset % CBF_BINARY_ALIGN != 0 ||
+      count > ((long long int)bm->mapsize - offset) / (long long int)size) {
+    *res = CBF_RES_ERR;
+    return NULL;
+  }
+
+  return bm->map + offset;
+}
@@ -18,12 +18,13 @@
 
 #include "frontend-mosek.h"
 #include "cbf-helper.h"
+#include "cbf-stream.h"
 #include "mosek.h"
 
 #include <stddef.h>
 
 static CBFresponsee
-  read(const char *file, CBFdata *data, CBFfrontendmemory *mem);
+  read(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
 
 static void
   clean(CBFdata *data, CBFfrontendmemory *mem);
@@ -88,7 +89,7 @@ CBFfrontend const frontend_mosek = { "mosek", read, clean };
 // Function definitions
 // -------------------------------------
 
-static CBFresponsee read(const char *file, CBFdata *data, CBFfrontendmemory *mem)
+static CBFresponsee read(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput)
 {
   MSKenv_t    env  = NULL;
   MSKtask_t   task = NULL;
@@ -135,7 +136,7 @@ static CBFresponsee read(const char *file, CBFdata *data, CBFfrontendmemory *mem
         res2 = MSK_readdata(task, file);
 
       if ( res2==MSK_RES_OK ) {
-        printf("<<<< Continued using old MPS format definition.\n");
+        fprintf(CBF_messagestream(), "<<<< Continued using old MPS format definition.\n");
         res = MSK_RES_OK;
       }
     }
@@ -148,9 +149,9 @@ static CBFresponsee read(const char *file, CBFdata *data, CBFfrontendmemory *mem
   {
     if (ptype==MSK_PROBTYPE_QO || ptype==MSK_PROBTYPE_QCQO)
     {
-      printf("*** Converting from quadratic to conic form using MSK_toconic ... ");
+      fprintf(CBF_messagestream(), "*** Converting from quadratic to conic form using MSK_toconic ... ");
       res = MSK_toconic(task);
-      printf("DONE.\n");
+      fprintf(CBF_messagestream(), "DONE.\n");
     }
   }
 
@@ -185,7 +186,7 @@ static CBFresponsee read(const char *file, CBFdata *data, CBFfrontendmemory *mem
   case MSK_RES_OK:
     return CBF_RES_OK;
   default:
-    printf("%s\n", response);
+    fprintf(CBF_messagestream(), "%s\n", response);
     clean(data, mem);
     return CBF_RES_ERR;
   }
@@ -276,7 +277,7 @@ static void clean(CBFdata *data, CBFfrontendmemory *mem)
 
 static void mosekprint(void *handle, MSKCONST char str[])
 {
-  printf("%s",str);
+  fprintf(CBF_messagestream(), "%s",str);
 }
 
 static MSKrescodee readVER(MSKtask_t task, CBFdyndata *dyndata)
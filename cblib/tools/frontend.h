@@ -21,15 +21,21 @@
 
 #include "cbf-data.h"
 #include "programmingstyle.h"
+#include <stddef.h>
 
 typedef void* CBFfrontendmemory;
 
 typedef struct CBFfrontend_struct {
 
   const char *name;
-  CBFresponsee (*read)(const char *file, CBFdata *data, CBFfrontendmemory *mem);
+  // With trustinput, indices are not checked to be in range (if the frontend checks them)
+  CBFresponsee (*read)(const char *file, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
   void (*clean)(CBFdata *data, CBFfrontendmemory *mem);
 
+  // Reads the content of a file from [buf, buf+len) instead (NULL if not
+  // supported). The buffer is not referenced after the call returns.
+  CBFresponsee (*readbuffer)(const char *buf, size_t len, CBFdata *data, CBFfrontendmemory *mem, int trustinput);
+
 } CBFfrontend;
 
 #endif
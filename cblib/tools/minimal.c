@@ -41,7 +41,7 @@ int main(int argc, char **argv)
     {
         const char * ifile = argv[1];
 
-        res = frontend_cbf.read(ifile, &data, &mem);
+        res = frontend_cbf_header.read(ifile, &data, &mem, 0);
 
         if (res != CBF_RES_OK) {
             printf("Failed to read file: %s\n", ifile);
@@ -49,10 +49,12 @@ int main(int argc, char **argv)
         else
         {
             printf("CON: %lli, VAR: %lli, PSDCON: %i, PSDVAR: %i\n", data.mapnum, data.varnum, data.psdmapnum, data.psdvarnum);
-        }
+            printf("OBJFNNZ: %lli, OBJANNZ: %lli, FNNZ: %lli, ANNZ: %lli, BNNZ: %lli, HNNZ: %lli, DNNZ: %lli\n",
+                   data.objfnnz, data.objannz, data.fnnz, data.annz, data.bnnz, data.hnnz, data.dnnz);
 
-        // Clean data structure
-        frontend_cbf.clean(&data, &mem);
+            // Clean data structure (the reader already did on failure)
+            frontend_cbf_header.clean(&data, &mem);
+        }
     }
 
     return 0;
@@ -19,6 +19,8 @@
 #include "frontend-mosek.h"
 #include "backend-cbf.h"
 #include "transform-none.h"
+#include "cbf-helper.h"
+#include "cbf-thread.h"
 
 #include "console.h"
 
@@ -40,6 +42,9 @@ int main (int argc, char *argv[])
   const char *ifile;
   const char *opath;
   const char *pfix;
+  const char *compress;
+  int threads;
+  bool inplacesort;
   bool verbose;
   int i;
 
@@ -61,6 +66,9 @@ int main (int argc, char *argv[])
   transform = default_transform = &transform_none;
   opath = NULL;
   pfix  = NULL;
+  compress = NULL;
+  threads = 0;
+  inplacesort = false;
   verbose = false;
 
   // User defined options
@@ -70,14 +78,22 @@ int main (int argc, char *argv[])
                    &transform,
                    &opath,
                    &pfix,
+                   &compress,
+                   &threads,
+                   NULL,
+                   NULL,
+                   &inplacesort,
                    &verbose);
 
+  CBF_setthreads(threads);
+  CBF_setinplacesort(inplacesort);
+
   if (argc <= 1 || res != CBF_RES_OK)
   {
     printf("\nBad command, syntax is:\n");
     printf(">> mosek2cbf [OPTIONS] infile1 infile2 infile3 ...\n\n");
     printoptions(plugs_frontend, plugs_backend, plugs_transform,
-            default_frontend, default_backend, default_transform);
+            default_frontend, default_backend, default_transform, false, false);
   }
   else
   {
@@ -85,9 +101,9 @@ int main (int argc, char *argv[])
     for (i=1; i<argc && res==CBF_RES_OK; ++i) {
       if (argv[i]) {
         ifile = argv[i];
-        ofile = swapfiledirandext(ifile, opath, pfix, backend->format);
+        ofile = swapfiledirandext(ifile, opath, pfix, backend->format, compress);
 
-        res = processfile(frontend, backend, transform, ifile, ofile.c_str(), verbose);
+        res = processfile(frontend, backend, transform, ifile, ofile.c_str(), false, verbose);
       }
     }
   }
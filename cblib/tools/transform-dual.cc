@@ -61,6 +61,9 @@ static CBFresponsee
 static CBFresponsee
   flip_signs(CBFdata *data, CBFtransform_flipsign *flipsign);
 
+static void
+  swap_sorted(CBFdata *data, int first, int second);
+
 // -------------------------------------
 // Global variable
 // -------------------------------------
@@ -114,6 +117,7 @@ static CBFresponsee swap_obja_b(CBFdata *data, CBFtransform_flipsign *flipsign)
   std::swap(data->objasubj, data->bsubi);
   std::swap(data->objaval,  data->bval);
   std::swap(flipsign->obja, flipsign->b);
+  swap_sorted(data, CBF_SORTED_OBJA, CBF_SORTED_B);
 
   // dualization flips signs
   flipsign->obja = !flipsign->obja;
@@ -131,6 +135,9 @@ static CBFresponsee swap_objf_d(CBFdata *data, CBFtransform_flipsign *flipsign)
   std::swap(data->objfval,  data->dval);
   std::swap(flipsign->objf, flipsign->d);
 
+  // order of objfcoord is not tracked
+  data->sorted &= ~CBF_SORTED_D;
+
   // dualization flips signs
   flipsign->objf = !flipsign->objf;
   flipsign->d    = !flipsign->d;
@@ -148,12 +155,16 @@ static CBFresponsee swap_f_h(CBFdata *data, CBFtransform_flipsign *flipsign)
   std::swap(data->fval,  data->hval);
   std::swap(flipsign->f, flipsign->h);
 
+  // row-major order of one is not that of the other, as 'i' and 'j' swap places
+  data->sorted &= ~(CBF_SORTED_F | CBF_SORTED_H);
+
   return CBF_RES_OK;
 }
 
 static CBFresponsee transpose_a(CBFdata *data, CBFtransform_flipsign *flipsign)
 {
   std::swap(data->asubi, data->asubj);
+  swap_sorted(data, CBF_SORTED_A, CBF_SORTED_ACOL);
 
   return CBF_RES_OK;
 }
@@ -165,6 +176,7 @@ static CBFresponsee remove_intvar(CBFdata *data, CBFtransform_flipsign *flipsign
     free(data->intvar);
     data->intvarnum = 0;
   }
+  data->sorted |= CBF_SORTED_INT;
 
   return CBF_RES_OK;
 }
@@ -272,3 +284,16 @@ static CBFresponsee flip_signs(CBFdata *data, CBFtransform_flipsign *flipsign)
 
   return CBF_RES_OK;
 }
+
+static void swap_sorted(CBFdata *data, int first, int second)
+{
+  int sorted = data->sorted & ~(first | second);
+
+  if (data->sorted & first)
+    sorted |= second;
+
+  if (data->sorted & second)
+    sorted |= first;
+
+  data->sorted = sorted;
+}